@@ -0,0 +1,36 @@
+#ifndef U16PANEL_APPLET_H
+#define U16PANEL_APPLET_H
+
+#include <stdbool.h>
+
+// Applets are shared objects exporting APPLET_ENTRY_NAME, the panel owns
+// their cell and calls update on every tick and draw only after a change.
+#define APPLET_API_VERSION 1
+#define APPLET_ENTRY_NAME  "u16panelApplet"
+
+// Applet Canvas (one cell of the panel back buffer, coordinates are cell relative)
+struct AppletCanvas
+{
+  int width;
+  int height;
+  void* host;
+  void (*drawText)(struct AppletCanvas* canvas, const char* text);
+  void (*drawBar)(struct AppletCanvas* canvas, float fraction);
+};
+
+// Applet Descriptor (returned by the entry point, must outlive the library handle)
+struct AppletDescriptor
+{
+  int apiVersion;
+  const char* name;
+  int intervalMs;
+  int cellWidth;
+  void* (*create)(void);
+  bool  (*update)(void* state);
+  void  (*draw)(void* state, struct AppletCanvas* canvas);
+  void  (*destroy)(void* state);
+};
+
+typedef const struct AppletDescriptor* (*AppletEntry)(void);
+
+#endif
@@ -1,21 +1,48 @@
+#define _GNU_SOURCE
 #include <X11/Xlib.h>
 #include <X11/xpm.h>
 #include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/keysym.h>
+#include <X11/Xresource.h>
+#include <X11/Xft/Xft.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <dlfcn.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <limits.h>
+#include <math.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <linux/sockios.h>
+#include <linux/tcp.h>
+
+#include "Applet.h"
 
 // Global Variables
 Display* display;
 Window panelWindow;
-Window menuWindow;
-Window dialogWindow;
+Window menuWindow = None;
+Window dialogWindow = None;
+Window tooltipWindow = None;
+Window triggerWindow = None;
 GC panelGC;
-GC menuGC;
-GC dialogGC;
+GC menuGC = NULL;
+GC dialogGC = NULL;
 
 // Colors
 unsigned long cPanelBackground;
@@ -30,20 +57,122 @@ unsigned long cDialogBackground;
 unsigned long cDialogForeground;
 unsigned long cDialogBorder;
 
-// Dimensions
+// Dimensions (unscaled, see calculateLayout)
 const int WINDOW_BORDER_WIDTH = 1;
 const int GAP_SIZE            = 4;
 const int ICON_BOX_SIZE       = 40;
 const int ICON_SIZE           = 32;
-const int ICON_INSET          = (ICON_BOX_SIZE - ICON_SIZE) / 2;
-const int PANEL_HEIGHT        = ICON_BOX_SIZE + 2 * GAP_SIZE;
 const int PANEL_BOTTOM_OFFSET = 0;
 const int ITEM_WIDTH          = 160;
 const int ITEM_HEIGHT         = 24;
+const int ITEM_TEXT_X         = 6;
+
+// Scaling
+const float  DEFAULT_DPI    = 96.0f;
+const float  MIN_SCALE      = 1.0f;
+const float  MAX_SCALE      = 4.0f;
+const char*  SCALE_ENV_NAME = "U16PANEL_SCALE";
+#define      ICON_MIP_LEVEL_COUNT 4
+const float  ICON_MIP_SCALES[ICON_MIP_LEVEL_COUNT] = { 1.0f, 1.5f, 2.0f, 3.0f };
+
+// Layout Struct (dimensions multiplied by the current scale)
+struct Layout
+{
+  float scale;
+  int borderWidth;
+  int gapSize;
+  int iconBoxSize;
+  int iconSize;
+  int iconInset;
+  int iconMipLevel;
+  int panelHeight;
+  int panelBottomOffset;
+  int triggerHeight;
+  int itemWidth;
+  int itemHeight;
+  int itemTextX;
+};
+
+// Text
+const char* FONT_FAMILY             = "sans-serif";
+const int   FONT_PIXEL_SIZE         = 12;
+const int   FONT_GLYPH_MEMORY_LIMIT = 512 * 1024;
+const int   LABEL_CACHE_LIMIT       = 64;
+
+// Tooltips
+const int TOOLTIP_DELAY_MS = 600;
+
+// Launcher
+const int          DIALOG_WIDTH       = 400;
+#define            DIALOG_ROW_LIMIT   8
+#define            DIALOG_QUERY_LIMIT 128
+const KeySym       HOTKEY_KEYSYM      = XK_space;
+const unsigned int HOTKEY_MODIFIERS   = Mod4Mask;
+const char*        DEFAULT_DATA_DIRS  = "/usr/local/share:/usr/share";
+const int          GRAB_ATTEMPTS      = 10;
+const int          GRAB_RETRY_MS      = 5;
+
+// Applets
+const char* APPLET_DIR_NAME     = "applets";
+const char* APPLET_DIR_ENV_NAME = "U16PANEL_APPLET_DIR";
+#define     APPLET_LIMIT        16
+const int   APPLET_COALESCE_MS  = 250;
+const int   APPLET_BAR_HEIGHT   = 3;
+
+// Dragging
+const int DRAG_THRESHOLD = 4;
+
+// Auto-Hide
+const bool  AUTO_HIDE             = true;
+const int   AUTO_HIDE_DELAY_MS    = 1000;
+const int   SLIDE_DURATION_MS     = 200;
+const int   TRIGGER_HEIGHT        = 2;
+const int   DEFAULT_REFRESH_RATE  = 60;
+const char* REFRESH_RATE_ENV_NAME = "U16PANEL_REFRESH_RATE";
+
+// Memory
+const size_t ARENA_CHUNK_SIZE                = 64 * 1024;
+const int    ICON_SLAB_SIZE                  = 64;
+const size_t INTERNED_STRING_MIN_CAPACITY    = 16;
+const size_t INTERNED_STRING_LIMIT           = 4096;
+#define      INTERNED_STRING_SIZE_CLASS_COUNT 9
+#define      INTERNED_STRING_BUCKET_COUNT     256
+
+// Files
+const char* DEFAULT_ICON_PATH = "icon.xpm";
+const char* PINS_FILE_NAME    = "pins";
+const char* SNAPSHOT_FILE_NAME = "snapshot";
+const char* HISTORY_FILE_NAME  = "history";
+const char* CATALOG_FILE_NAME  = "catalog";
+
+// Snapshot Format
+const char     SNAPSHOT_MAGIC[8]      = "U16SNAP";
+const uint32_t SNAPSHOT_VERSION       = 1;
+const int      SNAPSHOT_SAVE_DELAY_MS = 2000;
+
+// Launch History (the last magic character is the format version)
+const char   HISTORY_MAGIC[8]       = "U16HST1";
+const double HISTORY_HALF_LIFE_DAYS = 14.0;
+const int    HISTORY_FLUSH_DELAY_MS = 500;
+const int    HISTORY_COMPACT_SLACK  = 1024;
+#define      HISTORY_BUCKET_COUNT   256
+const bool   AUTO_PIN               = false;
+const int    AUTO_PIN_COUNT         = 5;
+const double AUTO_PIN_MIN_FRECENCY  = 4.0;
+
+// Executable Catalog (the last magic character is the format version)
+const char     CATALOG_MAGIC[8]    = "U16CAT1";
+const char*    DEFAULT_PATH        = "/usr/local/bin:/usr/bin:/bin";
+const uint32_t CATALOG_WATCH_MASK  = IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+const int      CATALOG_FUZZY_SCORE = 3;
+const size_t   CATALOG_SLACK       = 4096;
 
 // Limits
-const int ICON_COUNT_LIMIT = 16;
+const int   VISIBLE_ICON_LIMIT          = 16;
+const int   PIXMAP_BUDGET_DEFAULT_KB    = 16 * 1024;
+const char* PIXMAP_BUDGET_ENV_NAME      = "U16PANEL_PIXMAP_BUDGET_KB";
 const int ICON_NAME_LIMIT  = 48;
+const int ICON_ID_LIMIT    = 65536;
 
 // Menu Texts
 const char**       panelMenuTexts;
@@ -61,94 +190,628 @@ struct CurrentMenu
   int id;
 };
 
-// Icon Node
-struct IconNode
+// Icon Image (mip chain shared by every icon loaded from the same file, only the drawn level is on the server)
+struct IconImage
 {
+  char* path;
   Pixmap pixelMap;
   Pixmap mask;
-  char* name;
+  int residentLevel;
+  bool resident;
+  bool failed;
+  unsigned long lastUsedFrame;
+  unsigned int refCount;
+  char* pixelData;
+  bool pixelDataMapped;
+  int64_t sourceModified;
+  uint32_t snapshotIndex;
+  struct IconImage* next;
+};
+
+// Snapshot Header (panel state as laid out on disk, mapped read-only on startup)
+struct SnapshotHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t depth;
+  uint32_t bitsPerPixel;
+  uint32_t byteOrder;
+  uint32_t iconSize;
+  uint32_t entryCount;
+  uint32_t imageCount;
+  uint32_t reserved;
+  int64_t pinsModified;
+  uint64_t entriesOffset;
+  uint64_t imagesOffset;
+  uint64_t stringsOffset;
+  uint64_t fileSize;
+};
+
+// Snapshot Entry (one pinned icon, strings are offsets into the string blob)
+struct SnapshotEntry
+{
+  int32_t id;
+  uint32_t imageIndex;
+  uint64_t nameOffset;
+  uint64_t commandOffset;
+};
+
+// Snapshot Image (packed mip chain, pixelBytes is zero when never decoded)
+struct SnapshotImage
+{
+  uint64_t pathOffset;
+  int64_t sourceModified;
+  uint64_t pixelOffset;
+  uint64_t pixelBytes;
+};
+
+// Text Label (pre-rendered string, cached server-side)
+struct TextLabel
+{
+  char* text;
+  unsigned long foreground;
+  unsigned long background;
+  int requestedWidth;
+  int requestedHeight;
+  int width;
+  int height;
+  Pixmap pixelMap;
+  struct TextLabel* next;
+};
+
+// Text Label Cache Statistics
+struct TextLabelStats
+{
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+};
+
+// Arena Chunk (bump allocated, only released at exit)
+struct ArenaChunk
+{
+  struct ArenaChunk* next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+
+// Interned String (shared by every icon using the same text)
+struct InternedString
+{
+  struct InternedString* next;
+  unsigned int hash;
+  unsigned int refCount;
+  int sizeClass;
+  char text[];
+};
+
+// Icon Node (allocated from slabs, strings are interned and the image is shared)
+struct IconNode
+{
+  struct IconImage* image;
+  const char* name;
+  const char* command;
+  struct TextLabel* tooltip;
+  Window tooltipWindow;
   int id;
   struct IconNode* next;
 };
 
-// Window and X11 Settings
-const bool  SHOW_UNDER     = false;
-const char* X_DISPLAY_NAME = ":0";
+// Launcher Candidate (pinned icon or installed application, strings are interned)
+struct Candidate
+{
+  const char* name;
+  const char* command;
+  bool pinned;
+  int score;
+  double frecency;
+};
+
+// History Record (one launch, or a whole command after compaction, padded to 8 bytes)
+struct HistoryRecord
+{
+  uint32_t checksum;
+  uint32_t launchCount;
+  uint16_t commandLength;
+  uint16_t flags;
+  uint32_t reserved;
+  int64_t time;
+  double score;
+};
+
+// History Entry (frecency score valid at its reference time, decays from there)
+struct HistoryEntry
+{
+  const char* command;
+  double score;
+  int64_t referenceTime;
+  uint32_t launchCount;
+  struct HistoryEntry* next;
+};
+
+// Path Directory (executable names packed into one buffer, offsets sorted by name)
+struct PathDirectory
+{
+  char* path;
+  int64_t modified;
+  int watch;
+  bool loaded;
+  char* names;
+  size_t namesSize;
+  size_t namesCapacity;
+  size_t namesLive;
+  uint32_t* offsets;
+  int count;
+  int capacity;
+};
+
+// Catalog Record (one directory in the cache file, followed by its path and names)
+struct CatalogRecord
+{
+  int64_t modified;
+  uint32_t pathLength;
+  uint32_t namesSize;
+};
+
+// Applet Instance (loaded library and the cell it draws into)
+struct AppletInstance
+{
+  const struct AppletDescriptor* descriptor;
+  void* library;
+  void* state;
+  uint64_t interval;
+  uint64_t nextTick;
+  int x;
+  struct AppletCanvas canvas;
+};
+
+// Dialog Modes
+enum DialogMode
+{
+  DIALOG_MODE_LAUNCH,
+  DIALOG_MODE_ADD_ITEM
+};
+
+// Timers (deadlines in microseconds on the monotonic clock, 0 when disarmed)
+enum Timer
+{
+  TIMER_NONE = -1,
+  TIMER_TOOLTIP,
+  TIMER_AUTO_HIDE,
+  TIMER_FRAME,
+  TIMER_DRAG_FRAME,
+  TIMER_HISTORY_FLUSH,
+  TIMER_APPLET,
+  TIMER_SNAPSHOT_SAVE,
+  TIMER_COUNT
+};
+
+// Window and X11 Settings (the display comes from $DISPLAY, the name is the fallback)
+const bool  SHOW_UNDER           = false;
+const char* DEFAULT_DISPLAY_NAME = ":0";
+const char* REMOTE_ENV_NAME      = "U16PANEL_REMOTE";
 
 // Debugging
 const bool DEBUG_FUNCTIONS        = false;
 const bool DEBUG_MOTION_FUNCTIONS = false;
 const bool DEBUG_RENDER_ICON_IDS  = false;
+const bool DEBUG_TEXT_CACHE_STATS = false;
+const bool DEBUG_ANIMATION_STATS  = false;
+const bool DEBUG_LAUNCHER_LATENCY = false;
 
 // Initializer Functions
 void initializeColors();
 void initializeDisplay();
+void initializeLayout();
+void initializeText();
+void initializeIconImages();
 void initilalizeMenuTexts();
 void initializeMenu(int screenNum, unsigned long cBackground, unsigned int cBorder);
 void initializePanel(int screenNum, int panelX, int panelY, int panelWidth, unsigned long cBackground, unsigned int cBorder);
 void initializeDialog(int screenNum, unsigned long cBackground, unsigned long cBorder);
+void initializeTooltip(struct IconNode* icon, unsigned long cBorder);
+void initializeFramePacing();
+void initializeAutoHide(int screenNum, int screenWidth, int screenHeight);
+void ensureMenuWindow();
+void ensureDialogWindow();
+void ensureTooltipWindow(struct IconNode* icon);
+
+// Startup Functions
+void parseArguments(int argc, char** argv);
+void traceStartupPhase(const char* phase);
+
+// Connection Functions
+bool        isRemoteConnection();
+void        noteRoundTrips(int count);
+bool        readConnectionBytes(uint64_t* bytesOut, uint64_t* bytesIn);
+void        beginTrafficInteraction(const char* label);
+void        reportTraffic();
+const char* describeInteraction(int timer, XEvent* event);
 
 // Visibility Functions
 void showPanel();
 void refreshPanel(int iconCount, int screenWidth, int screenHeight);
 void showMenu();
-void showMenuAt(int x, int y, int itemCount);
-void clearMenu();
+void showMenuAt(int x, int y, const char** menuItems, int itemCount);
 void hideMenu();
-void showDialog();
+void showDialog(int mode);
 void hideDialog();
+void showTooltipAtIndex(int index);
+void hideTooltip();
+
+// Launcher Functions
+void              initializeHotkey();
+int               catchGrabError(Display* errorDisplay, XErrorEvent* error);
+void              loadApplications();
+void              loadApplicationDirectory(const char* path);
+void              loadApplicationFile(const char* path);
+void              filterCandidates();
+void              considerCandidate(const char* name, const char* command, bool pinned, int64_t now);
+void              insertCandidate(const char* name, const char* command, bool pinned, int score, int64_t now);
+void              renderDialog();
+void              resizeDialog();
+struct Candidate* handleDialogKey(XKeyEvent* event);
+void              launchCommand(const char* command);
+
+// History Functions
+void                 loadHistory();
+struct HistoryEntry* mergeHistoryRecord(const char* command, int64_t launchTime, double score, uint32_t launchCount);
+struct HistoryEntry* getHistoryEntry(const char* command);
+double               readFrecency(const char* command, int64_t now);
+double               decayFrecency(double score, int64_t from, int64_t to);
+void                 recordLaunch(const char* command);
+void                 appendHistoryRecord(const char* command, int64_t launchTime, double score, uint32_t launchCount, char** buffer, size_t* size, size_t* capacity);
+void                 appendHistoryBytes(const void* bytes, size_t length, char** buffer, size_t* size, size_t* capacity);
+size_t               calculateHistoryRecordSize(size_t commandLength);
+uint32_t             calculateHistoryChecksum(const struct HistoryRecord* record, const char* command);
+void                 flushHistory();
+void                 compactHistory();
+void                 finishHistoryCompaction(bool block);
+bool                 autoPinCommand(const char* name, const char* command);
+
+// Catalog Functions
+void                  loadCatalog();
+void                  loadCatalogCache();
+void                  saveCatalog();
+void                  scanPathDirectory(struct PathDirectory* directory);
+bool                  isExecutableAt(int directoryFd, const char* name);
+struct PathDirectory* getPathDirectoryByPath(const char* path, size_t length);
+struct PathDirectory* getPathDirectoryByWatch(int watch);
+int                   findCatalogName(struct PathDirectory* directory, const char* name);
+void                  insertCatalogName(struct PathDirectory* directory, int position, const char* name);
+void                  addCatalogName(struct PathDirectory* directory, const char* name);
+void                  removeCatalogName(struct PathDirectory* directory, const char* name);
+void                  compactCatalogNames(struct PathDirectory* directory);
+int                   compareCatalogOffsets(const void* first, const void* second, void* names);
+int                   compareCatalogNames(const void* first, const void* second);
+void                  rebuildCatalogIndex();
+void                  readCatalogChanges();
+void                  rewatchPathDirectories();
+void                  matchCatalog(int64_t now);
+int                   calculateCatalogScore(const char* name);
+
+// Applet Functions
+void loadApplets();
+void loadApplet(const char* path);
+int  layoutApplets(int x);
+void tickApplets();
+void scheduleApplets();
+void renderApplets();
+void renderAppletCell(struct AppletInstance* applet);
+void drawAppletText(struct AppletCanvas* canvas, const char* text);
+void drawAppletBar(struct AppletCanvas* canvas, float fraction);
+
+// Animation Functions
+void startPanelSlide(bool hide);
+void advancePanelSlide();
+int  calculateHiddenPanelY();
+void beginIconDrag(int index, int pointerX);
+void updateIconDrag(int pointerX);
+void advanceIconDrag();
+bool finishIconDrag();
+void cancelIconDrag();
+void renderDragArea(int x, int width);
+int  calculateDragIconAtSlot(int slot);
 
 // Pointer Functions
 void grabPointer();
 void releasePointer();
 
 // Render Functions
+void renderPanel(int hoveredIndex);
+void presentPanelArea(int x, int y, int width, int height);
+void presentIconAtIndex(int index);
+void presentIconSpan(int firstIndex, int secondIndex);
 void renderIconAtIndex(int index);
 void renderIconHoverAtIndex(int index);
-void renderIcons();
+void renderIcons(int hoveredIndex);
 void renderIconPixelMapAtIndex(int index);
-void renderIconPixelMaps(struct IconNode* iconList);
+void renderIconPixelMapAtX(int index, int iconX);
+void renderIconPixelMaps();
 void renderIconIdAtIndex(int index);
-void renderIconIds(struct IconNode* iconList);
-void renderMenuHoverAtIndex(int index);
-void renderMenuItems(const char** menuItems, int itemCount);
+void renderIconIds();
+void renderMenuItemAtIndex(const char** menuItems, int index, bool hovered);
+void renderMenuArea(int x, int y, int width, int height);
+void composeMenuBuffer(const char** menuItems, int itemCount);
+void freeMenuBuffer();
+
+// Text Functions
+void   loadFont(float scale);
+struct TextLabel* getTextLabel(const char* text, unsigned long foreground, unsigned long background, int width, int height);
+struct TextLabel* createTextLabel(const char* text, unsigned long foreground, unsigned long background, int width, int height);
+void   renderTextLabel(struct TextLabel* label);
+void   freeTextLabel(struct TextLabel* label);
+void   flushTextLabels();
+void   toXftColor(unsigned long pixel, XftColor* color);
+
+// Scaling Functions
+float readScale(const char* resourceString);
+char* readResourceManagerProperty();
+void  calculateLayout(float scale);
+void  applyScale(float scale);
+int   scaleDimension(int size, float scale);
+int   selectIconMipLevel(float scale);
+int   calculateIconMipSize(int level);
 
 // Calculation Functions
-int calculatePanelWidth(int iconCount);
-int calculateIconIndexFromMouseX(int relMouseX, int iconCount);
+int  calculatePanelWidth(int iconCount);
+int  calculateVisibleIconCount(int iconCount, int screenWidth);
+void calculateVisibleIconRange(int* first, int* last);
+int  calculateIconX(int index);
+int  clipToIconArea(int x, int width);
+bool scrollPanel(int delta);
+int  calculateIconIndexFromMouseX(int relMouseX, int iconCount);
 int calculateItemIndexFromMouseY(int relMouseY, int itemCount);
 
 // Icon Functions
-void             loadPixelMap(Pixmap* map, Pixmap* mask, const char* filePath, int* width, int* height);
-void             scalePixelMap(Pixmap* baseMap, Pixmap* baseMask, int baseWidth, int baseHeight, int newWidth, int newHeight);
-struct IconNode* createIcon(const char* name);
-void             addIcon(const char* name);
+struct IconImage* loadIconImage(const char* filePath);
+void             releaseIconImage(struct IconImage* image);
+bool             loadPendingIconImage();
+void             makeIconImageResident(struct IconImage* image);
+void             unloadIconImage(struct IconImage* image);
+void             evictIconImages();
+unsigned long    calculateIconImageBytes(int level);
+void             buildIconMipChain(struct IconImage* image, XImage* source, XImage* shape);
+float*           unpackIconPixels(XImage* source, XImage* shape);
+void             resampleIconPixels(const float* source, int sourceWidth, int sourceHeight, float* target, int targetSize);
+void             packIconPixels(const float* pixels, int size, char* pixelData, char* maskData);
+void             uploadIconImage(struct IconImage* image);
+size_t           calculatePackedIconBytes();
+void             calculatePackedLevel(int level, size_t* pixelOffset, size_t* maskOffset, int* bytesPerLine);
+struct IconNode* createIcon(const char* name, const char* command);
+void             destroyIcon(struct IconNode* icon);
+void             freeIconTooltip(struct IconNode* icon);
+void             addIcon(const char* name, const char* command);
+void             addIconWithId(int id, const char* name, const char* command, const char* iconPath);
 struct IconNode* getIconByIndex(int index);
+void             rebuildIconTable();
 unsigned int     getIconCount();
 void             moveIconToLeftByIndex(int index);
 void             moveIconToRightByIndex(int index);
+void             moveIconToIndex(int index, int targetIndex);
 void             removeIconByIndex(int index);
-unsigned int     generateIconId();
+int              allocateIconId();
+bool             reserveIconId(int id);
+void             releaseIconId(int id);
+struct IconNode* getIconById(int id);
 
-// Program Functions
-void openTerminal();
+// Persistence Functions
+bool        resolveStatePath(char* buffer, size_t size, const char* envName, const char* fallback, const char* fileName);
+bool        loadPins();
+void        savePins();
+int64_t     readModificationTime(const char* path);
+bool        loadSnapshot();
+const char* readSnapshotString(const char* data, size_t size, uint64_t stringsOffset, uint64_t offset);
+void        saveSnapshot();
+uint64_t    appendSnapshotString(char** strings, size_t* size, size_t* capacity, const char* text);
+
+// Memory Functions
+void*            allocateFromArena(size_t size);
+const char*      internString(const char* text, size_t limit);
+const char*      findInternedString(const char* text);
+unsigned int     calculateStringHash(const char* text, size_t length);
+void             releaseString(const char* text);
+struct IconNode* allocateIconNode();
+void             releaseIconNode(struct IconNode* icon);
+long             readResidentSetSize();
+long             readServerPixmapBytes();
+void             runSoakTest(int cycles, int screenWidth, int screenHeight);
+
+// Timer Functions
+uint64_t currentTime();
+uint64_t currentCpuTime();
+void     armTimer(int timer, uint64_t delay);
+void     armTimerAt(int timer, uint64_t deadline);
+void     disarmTimer(int timer);
+int      waitForEvent(XEvent* event);
 
 // Utility Functions
 unsigned long calculateRGB(uint8_t red, u_int8_t green, uint8_t blue);
 
 // Cleanup Functions
+void freeIcons();
 void freePixelMaps();
 void freeTexts();
+void freeFont();
 void freeXObjects();
+void freeSnapshot();
+void freeCandidates();
+void freeHistory();
+void freeApplets();
+void freeCatalog();
 
 // Icon Linked List
 struct IconNode* iconList = NULL;
 
-int main()
+// Icon Memory (node slabs and strings live in the arena)
+struct ArenaChunk* arenaChunkList = NULL;
+struct IconNode* freeIconNodeList = NULL;
+struct InternedString* internedStringBuckets[INTERNED_STRING_BUCKET_COUNT];
+struct InternedString* freeStringLists[INTERNED_STRING_SIZE_CLASS_COUNT];
+
+// Icon IDs (bitmap of used IDs and the node owning each one)
+uint64_t* iconIdBitmap = NULL;
+struct IconNode** iconIdTable = NULL;
+int iconIdWordCount = 0;
+
+// Icon Lookup Table (index -> node, rebuilt whenever the list changes)
+struct IconNode** iconTable = NULL;
+unsigned int iconTableCount = 0;
+unsigned int iconTableCapacity = 0;
+
+// Icon Image Cache (pending images are neither resident nor failed, the cursor is where the remote walk resumes)
+struct IconImage* iconImageList = NULL;
+unsigned long residentIconImageBytes = 0;
+unsigned long pixmapBudget = 0;
+int pendingIconImageCount = 0;
+int pendingIconCursor = 0;
+
+// Packed Pixel Format (server ZPixmap layout the icon pixels are kept in)
+int packedDepth = 0;
+int packedBitsPerPixel = 0;
+int packedByteOrder = 0;
+
+// Snapshot Mapping
+const char* snapshotData = NULL;
+size_t snapshotSize = 0;
+
+// Panel Back Buffer and Scrolling
+Pixmap panelBuffer = None;
+int panelBufferWidth = 0;
+int panelIconAreaWidth = 0;
+int panelContentWidth = 0;
+int panelScrollOffset = 0;
+int panelX = 0;
+int panelY = 0;
+unsigned long panelFrame = 0;
+
+// Timer Deadlines
+uint64_t timerDeadlines[TIMER_COUNT];
+
+// Auto-Hide and Slide Animation (frame deadlines are counted from the slide start)
+bool panelHidden = false;
+bool panelSliding = false;
+int panelCurrentY = 0;
+int slideFromY = 0;
+int slideToY = 0;
+uint64_t slideStartTime = 0;
+uint64_t slideCpuStartTime = 0;
+uint64_t frameInterval = 0;
+uint64_t slideDuration = 0;
+int slideFrame = 0;
+int slideDroppedFrames = 0;
+bool pointerInsidePanel = false;
+
+// Icon Drag (the dragged icon is drawn at dragDrawnX, dragTargetIndex is its drop slot)
+bool iconPressed = false;
+bool iconDragging = false;
+int pressedIconIndex = -1;
+int pressX = 0;
+int dragIndex = -1;
+int dragTargetIndex = -1;
+int dragPointerX = 0;
+int dragGrabOffset = 0;
+int dragDrawnX = 0;
+uint64_t lastDragFrameTime = 0;
+
+// Launcher Dialog (the buffer is the window background, candidates stay loaded)
+Pixmap dialogBuffer = None;
+int dialogWidth = 0;
+int dialogHeight = 0;
+bool dialogShown = false;
+int dialogMode = DIALOG_MODE_LAUNCH;
+char dialogQuery[DIALOG_QUERY_LIMIT];
+int dialogQueryLength = 0;
+struct Candidate dialogMatches[DIALOG_ROW_LIMIT];
+int dialogMatchCount = 0;
+int dialogSelection = 0;
+struct Candidate* applicationCandidates = NULL;
+int applicationCandidateCount = 0;
+int applicationCandidateCapacity = 0;
+bool hotkeyGrabDenied = false;
+
+// Launch History (entries live in the arena, appends wait in the pending buffer)
+struct HistoryEntry* historyBuckets[HISTORY_BUCKET_COUNT];
+int historyEntryCount = 0;
+int historyRecordCount = 0;
+int historyFile = -1;
+char* historyPending = NULL;
+size_t historyPendingSize = 0;
+size_t historyPendingCapacity = 0;
+
+// History Compaction (a child writes the compacted file, appends made meanwhile are carried over)
+pid_t historyCompactor = -1;
+int historyCompactedRecordCount = 0;
+int historyForkRecordCount = 0;
+char* historyCarry = NULL;
+size_t historyCarrySize = 0;
+size_t historyCarryCapacity = 0;
+
+// Executable Catalog (one entry per $PATH directory, merged into a sorted index on demand)
+struct PathDirectory* pathDirectories = NULL;
+int pathDirectoryCount = 0;
+const char** catalogIndex = NULL;
+int catalogIndexCount = 0;
+bool catalogIndexStale = false;
+bool catalogChanged = false;
+int catalogNotify = -1;
+
+// Tooltip State (every icon owns its tooltip window, this is the one last shown)
+bool tooltipShown = false;
+
+// Current Layout
+struct Layout layout;
+
+// Applets (cells to the right of the icon area, ticked from one shared timer)
+struct AppletInstance applets[APPLET_LIMIT];
+int appletCount = 0;
+
+// Startup Trace (phases are printed relative to the start of main, uploads split by where the pixels came from)
+bool traceStartup = false;
+uint64_t startupTime = 0;
+int startupDecodedIcons = 0;
+int startupUploadedIcons = 0;
+
+// Soak Test (cycles come from --soak-test, the panel stays unmapped and the process exits)
+int soakCycles = 0;
+
+// Remote Display (every request and reply crosses the network)
+bool remoteDisplay = false;
+
+// Traffic Trace (counters as of the start of the current interaction)
+bool traceTraffic = false;
+const char* trafficLabel = NULL;
+unsigned long trafficRequest = 0;
+int roundTripCount = 0;
+int trafficRoundTrips = 0;
+uint64_t trafficBytesOut = 0;
+uint64_t trafficBytesIn = 0;
+
+// Menu Back Buffer (rows in their normal state, grown on demand)
+Pixmap menuBuffer = None;
+int menuBufferRows = 0;
+int menuBufferWidth = 0;
+int menuBufferItemCount = 0;
+
+// Font and Text Label Cache (most recently used first)
+XftFont* font = NULL;
+struct TextLabel* textLabelList = NULL;
+int textLabelCount = 0;
+struct TextLabelStats textLabelStats;
+
+int main(int argc, char** argv)
 {
+  startupTime = currentTime();
+  parseArguments(argc, argv);
   initializeColors();
   initializeDisplay();
+  traceStartupPhase(remoteDisplay ? "connect (remote)" : "connect");
+  initializeLayout();
+  initializeText();
+  initializeIconImages();
   initilalizeMenuTexts();
+  traceStartupPhase("layout and font");
 
   int screenNum = DefaultScreen(display);
   int screenWidth = DisplayWidth(display, screenNum);
@@ -158,35 +821,54 @@ int main()
   initializePanel(
     screenNum,
     screenWidth / 2 - panelWidth / 2,
-    screenHeight - PANEL_HEIGHT - PANEL_BOTTOM_OFFSET - WINDOW_BORDER_WIDTH,
+    screenHeight - layout.panelHeight - layout.panelBottomOffset - layout.borderWidth,
     panelWidth,
     cPanelBackground,
     cPanelBorder
   );
-  initializeMenu(
-    screenNum,
-    cMenuBackground,
-    cMenuBorder
-  );
-  initializeDialog(
-    screenNum,
-    cDialogBackground,
-    cDialogBorder
-  );
+  // Menu, dialog and tooltip windows are created on first use
+  initializeFramePacing();
+  if (soakCycles > 0)
+  {
+    // Runs against the private, never mapped panel and leaves pins, snapshot and history alone
+    runSoakTest(soakCycles, screenWidth, screenHeight);
+    freeIcons();
+    freePixelMaps();
+    freeTexts();
+    freeFont();
+    freeXObjects();
+    return EXIT_SUCCESS;
+  }
+  if (AUTO_HIDE) initializeAutoHide(screenNum, screenWidth, screenHeight);
   showPanel();
+  traceStartupPhase("panel window created");
 
-  // Icon Linked List
-  addIcon("Icon 1");
-  addIcon("Icon 2");
-  addIcon("Icon 3");
-  addIcon("Icon 4");
-  addIcon("Icon 5");
+  // Icon Linked List (the snapshot carries pixels too, the pins file is the fallback)
+  bool warmStart = loadSnapshot();
+  if (!warmStart && !loadPins())
+  {
+    addIcon("Icon 1", "alacritty");
+    addIcon("Icon 2", "alacritty");
+    addIcon("Icon 3", "alacritty");
+    addIcon("Icon 4", "alacritty");
+    addIcon("Icon 5", "alacritty");
+    savePins();
+  }
+  traceStartupPhase(warmStart ? "icons listed from snapshot" : "icons listed from pins");
+  loadApplets();
+  traceStartupPhase("applets loaded");
 
   int iconCount = getIconCount(iconList);
   panelWidth = calculatePanelWidth(iconCount);
   refreshPanel(iconCount, screenWidth, screenHeight);
+  if (AUTO_HIDE) armTimer(TIMER_AUTO_HIDE, AUTO_HIDE_DELAY_MS * 1000);
+  initializeHotkey();
+  scheduleApplets();
+  traceStartupPhase("panel rendered");
 
   XEvent event;
+  bool panelExposed = false;
+  bool startupFinished = false;
   int hoveredPanelIndex = -1;
   int hoveredMenuIndex = -1;
   int lastClickedPanelIndex = -1;
@@ -202,38 +884,129 @@ int main()
 
   while (running)
   {
-    XNextEvent(display, &event);
+    if (traceTraffic) reportTraffic();
+
+    // Icons stream in only after the panel has been on screen once
+    if (panelExposed && XPending(display) == 0 && loadPendingIconImage())
+    {
+      renderPanel(hoveredPanelIndex);
+      continue;
+    }
+    if (panelExposed && !startupFinished)
+    {
+      if (traceStartup) XSync(display, False);
+      char phase[64];
+      snprintf(phase, sizeof(phase), "icons ready (%d uploaded, %d decoded)", startupUploadedIcons, startupDecodedIcons);
+      traceStartupPhase(phase);
+      loadApplications();
+      loadHistory();
+      loadCatalog();
+      traceStartupPhase("applications, history and catalog loaded");
+      startupFinished = true;
+    }
+    int firedTimer = waitForEvent(&event);
+    if (traceTraffic) beginTrafficInteraction(describeInteraction(firedTimer, &event));
+    if (firedTimer == TIMER_TOOLTIP)
+    {
+      if (hoveredPanelIndex >= 0 && !menuShown) showTooltipAtIndex(hoveredPanelIndex);
+      continue;
+    }
+    if (firedTimer == TIMER_AUTO_HIDE)
+    {
+      if (menuShown || iconDragging) armTimer(TIMER_AUTO_HIDE, AUTO_HIDE_DELAY_MS * 1000);
+      else startPanelSlide(true);
+      continue;
+    }
+    if (firedTimer == TIMER_FRAME)
+    {
+      advancePanelSlide();
+      continue;
+    }
+    if (firedTimer == TIMER_APPLET)
+    {
+      tickApplets();
+      continue;
+    }
+    if (firedTimer == TIMER_HISTORY_FLUSH)
+    {
+      flushHistory();
+      continue;
+    }
+    if (firedTimer == TIMER_SNAPSHOT_SAVE)
+    {
+      saveSnapshot();
+      continue;
+    }
+    if (firedTimer == TIMER_DRAG_FRAME)
+    {
+      if (iconDragging) advanceIconDrag();
+      continue;
+    }
     switch (event.type)
     {
       case Expose:
         {
           if (event.xexpose.window == panelWindow)
           {
-            renderIcons(-1);
-            renderIconPixelMaps(iconList);
-            renderIconIds(iconList);
+            if (!panelExposed) traceStartupPhase("first Expose");
+            panelExposed = true;
+            presentPanelArea(event.xexpose.x, event.xexpose.y, event.xexpose.width, event.xexpose.height);
           }
           else if (event.xexpose.window == menuWindow && currentMenu.texts != NULL)
           {
-            clearMenu();
-            renderMenuItems(*currentMenu.texts, currentMenu.itemCount);
+            renderMenuArea(event.xexpose.x, event.xexpose.y, event.xexpose.width, event.xexpose.height);
+            int hoverY = hoveredMenuIndex * layout.itemHeight;
+            if (
+              hoveredMenuIndex >= 0 &&
+              hoverY < event.xexpose.y + event.xexpose.height &&
+              hoverY + layout.itemHeight > event.xexpose.y
+            )
+            {
+              renderMenuItemAtIndex(*currentMenu.texts, hoveredMenuIndex, true);
+            }
           }
           break;
         }
       case MotionNotify:
         {
-          if (event.xmotion.window == panelWindow && !menuShown)
+          // Remotely a burst of motion collapses into its last position
+          XEvent nextEvent;
+          while (remoteDisplay && XEventsQueued(display, QueuedAfterReading) > 0)
+          {
+            XPeekEvent(display, &nextEvent);
+            if (nextEvent.type != MotionNotify || nextEvent.xmotion.window != event.xmotion.window) break;
+            XNextEvent(display, &event);
+          }
+          if (event.xmotion.window == panelWindow && iconPressed && pressedIconIndex >= 0)
+          {
+            if (!iconDragging && abs(event.xmotion.x - pressX) >= scaleDimension(DRAG_THRESHOLD, layout.scale))
+            {
+              hideTooltip();
+              hoveredPanelIndex = -1;
+              beginIconDrag(pressedIconIndex, pressX);
+            }
+            if (iconDragging) updateIconDrag(event.xmotion.x);
+          }
+          if (event.xmotion.window == panelWindow && !menuShown && !iconDragging)
           {
             int calculatedIndex = calculateIconIndexFromMouseX(event.xmotion.x, iconCount);
             if (hoveredPanelIndex != calculatedIndex)
             {
-              renderIconAtIndex(hoveredPanelIndex);
-              renderIconPixelMapAtIndex(hoveredPanelIndex);
-              renderIconIdAtIndex(hoveredPanelIndex);
+              // Both icons are redrawn in the back buffer and reach the window in one copy
+              int previousIndex = hoveredPanelIndex;
+              renderIconAtIndex(previousIndex);
+              renderIconPixelMapAtIndex(previousIndex);
+              renderIconIdAtIndex(previousIndex);
               hoveredPanelIndex = calculatedIndex;
               renderIconHoverAtIndex(hoveredPanelIndex);
               renderIconPixelMapAtIndex(hoveredPanelIndex);
               renderIconIdAtIndex(hoveredPanelIndex);
+              presentIconSpan(previousIndex, hoveredPanelIndex);
+
+              // A visible tooltip follows the pointer, otherwise restart the delay
+              if (hoveredPanelIndex < 0) hideTooltip();
+              else if (tooltipShown) showTooltipAtIndex(hoveredPanelIndex);
+              else if (!remoteDisplay) armTimer(TIMER_TOOLTIP, TOOLTIP_DELAY_MS * 1000);
             }
           }
           else if (event.xmotion.window == menuWindow && currentMenu.texts != NULL && mouseInsideMenu)
@@ -241,12 +1014,108 @@ int main()
             int calculatedIndex = calculateItemIndexFromMouseY(event.xmotion.y, currentMenu.itemCount);
             if (hoveredMenuIndex != calculatedIndex)
             {
+              renderMenuItemAtIndex(*(currentMenu.texts), hoveredMenuIndex, false);
               hoveredMenuIndex = calculatedIndex;
-              clearMenu();
-              renderMenuHoverAtIndex(hoveredMenuIndex);
-              renderMenuItems(*(currentMenu.texts), currentMenu.itemCount);
+              renderMenuItemAtIndex(*(currentMenu.texts), hoveredMenuIndex, true);
+            }
+          }
+          break;
+        }
+      case PropertyNotify:
+        {
+          if (event.xproperty.window == DefaultRootWindow(display) && event.xproperty.atom == XA_RESOURCE_MANAGER)
+          {
+            char* resourceString = readResourceManagerProperty();
+            float scale = readScale(resourceString);
+            if (resourceString != NULL) XFree(resourceString);
+            if (scale != layout.scale)
+            {
+              if (menuShown)
+              {
+                hideMenu();
+                menuShown = false;
+                hoveredMenuIndex = -1;
+              }
+              hoveredPanelIndex = -1;
+              hideTooltip();
+              applyScale(scale);
+              refreshPanel(iconCount, screenWidth, screenHeight);
+            }
+          }
+          break;
+        }
+      case KeyPress:
+        {
+          uint64_t keyTime = currentTime();
+          if (!dialogShown)
+          {
+            // Only the hotkey reaches us while the dialog is closed
+            hideTooltip();
+            if (menuShown)
+            {
+              hideMenu();
+              menuShown = false;
+              hoveredMenuIndex = -1;
+            }
+            showDialog(DIALOG_MODE_LAUNCH);
+          }
+          else
+          {
+            struct Candidate* chosen = handleDialogKey(&event.xkey);
+            if (chosen != NULL)
+            {
+              if (dialogMode == DIALOG_MODE_ADD_ITEM)
+              {
+                addIcon(chosen->name, chosen->command);
+                iconCount = getIconCount();
+                savePins();
+                refreshPanel(iconCount, screenWidth, screenHeight);
+              }
+              else
+              {
+                launchCommand(chosen->command);
+                if (AUTO_PIN && autoPinCommand(chosen->name, chosen->command))
+                {
+                  iconCount = getIconCount();
+                  savePins();
+                  refreshPanel(iconCount, screenWidth, screenHeight);
+                }
+              }
+              hideDialog();
+            }
+          }
+          if (DEBUG_LAUNCHER_LATENCY)
+          {
+            XSync(display, False);
+            printf("key to paint after %.2f ms\n", (currentTime() - keyTime) / 1000.0);
+          }
+          break;
+        }
+      case ButtonRelease:
+        {
+          if (event.xbutton.button != Button1 || !iconPressed) break;
+          iconPressed = false;
+          if (event.xbutton.window != panelWindow)
+          {
+            // A grab sent the release elsewhere, so it neither launches nor drops
+            if (iconDragging)
+            {
+              cancelIconDrag();
+              renderPanel(-1);
             }
+            break;
+          }
+          if (!iconDragging)
+          {
+            struct IconNode* icon = getIconByIndex(pressedIconIndex);
+            if (icon != NULL) launchCommand(icon->command);
+            break;
           }
+          if (finishIconDrag()) savePins();
+          bool inside = event.xbutton.x >= 0 && event.xbutton.x < panelIconAreaWidth && event.xbutton.y >= 0 && event.xbutton.y < layout.panelHeight;
+          hoveredPanelIndex = inside ? calculateIconIndexFromMouseX(event.xbutton.x, iconCount) : -1;
+          renderPanel(hoveredPanelIndex);
+          if (!inside && AUTO_HIDE) armTimer(TIMER_AUTO_HIDE, AUTO_HIDE_DELAY_MS * 1000);
           break;
         }
       case EnterNotify:
@@ -255,22 +1124,36 @@ int main()
           {
             mouseInsideMenu = true;
           }
+          else if (event.xcrossing.window == panelWindow)
+          {
+            pointerInsidePanel = true;
+            disarmTimer(TIMER_AUTO_HIDE);
+          }
+          else if (event.xcrossing.window == triggerWindow)
+          {
+            startPanelSlide(false);
+          }
           break;
         }
       case LeaveNotify:
         {
-          if (event.xcrossing.window == panelWindow)
+          if (event.xcrossing.window == panelWindow) pointerInsidePanel = false;
+          if (event.xcrossing.window == panelWindow && !iconDragging)
           {
             XSetForeground(display, panelGC, cIconBackground);
             renderIconAtIndex(hoveredPanelIndex);
             renderIconPixelMapAtIndex(hoveredPanelIndex);
             renderIconIdAtIndex(hoveredPanelIndex);
+            presentIconAtIndex(hoveredPanelIndex);
             hoveredPanelIndex = -1;
+            hideTooltip();
+
+            // Leaving for a menu grab still counts, the timer waits for the menu to close
+            if (AUTO_HIDE) armTimer(TIMER_AUTO_HIDE, AUTO_HIDE_DELAY_MS * 1000);
           }
           else if (event.xcrossing.window == menuWindow)
           {
-            clearMenu();
-            renderMenuItems(*(currentMenu.texts), currentMenu.itemCount);
+            renderMenuItemAtIndex(*(currentMenu.texts), hoveredMenuIndex, false);
             hoveredMenuIndex = -1;
             mouseInsideMenu = false;
           }
@@ -278,35 +1161,40 @@ int main()
         }
       case ButtonPress:
         {
+          hideTooltip();
           if (event.xbutton.button == Button1)
           {
-            if (event.xbutton.window == menuWindow && event.xbutton.y < currentMenu.itemCount * ITEM_HEIGHT && mouseInsideMenu)
+            if (event.xbutton.window == menuWindow && event.xbutton.y < currentMenu.itemCount * layout.itemHeight && mouseInsideMenu)
             {
-              int actionIndex = event.xbutton.y / ITEM_HEIGHT;
+              int actionIndex = event.xbutton.y / layout.itemHeight;
               if (currentMenu.id == iconMenuId)
               {
                 if (actionIndex == 0)
                 {
                   removeIconByIndex(lastClickedPanelIndex);
-                  iconCount--;
+                  iconCount = getIconCount();
                   lastClickedPanelIndex = -1;
+                  savePins();
                   refreshPanel(iconCount, screenWidth, screenHeight);
                 }
                 else if (actionIndex == 1)
                 {
                   moveIconToLeftByIndex(lastClickedPanelIndex);
                   lastClickedPanelIndex = -1;
+                  savePins();
                   refreshPanel(iconCount, screenWidth, screenHeight);
                 }
                 else if (actionIndex == 2)
                 {
                   moveIconToRightByIndex(lastClickedPanelIndex);
                   lastClickedPanelIndex = -1;
+                  savePins();
                   refreshPanel(iconCount, screenWidth, screenHeight);
                 }
                 else if (actionIndex == 3)
                 {
-                  openTerminal();
+                  struct IconNode* icon = getIconByIndex(lastClickedPanelIndex);
+                  if (icon != NULL) launchCommand(icon->command);
                 }
                 hideMenu();
                 menuShown = false;
@@ -314,11 +1202,11 @@ int main()
               }
               else if (currentMenu.id == panelMenuId)
               {
-                if (actionIndex == 0 && iconCount < ICON_COUNT_LIMIT)
+                if (actionIndex == 0)
                 {
-                  showDialog();
+                  showDialog(DIALOG_MODE_ADD_ITEM);
                   /*
-                  addIcon("Icon");
+                  addIcon("Icon", "alacritty");
                   iconCount++;
                   refreshPanel(iconCount, screenWidth, screenHeight);
                   */
@@ -337,7 +1225,10 @@ int main()
             {
               if (!menuShown)
               {
-                openTerminal();
+                // Launching waits for the release, the press may start a drag
+                iconPressed = true;
+                pressedIconIndex = calculateIconIndexFromMouseX(event.xbutton.x, iconCount);
+                pressX = event.xbutton.x;
               }
               else
               {
@@ -382,18 +1273,44 @@ int main()
               currentMenu.itemCount = iconMenuItemCount;
               currentMenu.id = iconMenuId;
             }
-            showMenuAt(event.xbutton.x_root, event.xbutton.y_root, currentMenu.itemCount);
+            // The menu grabs the pointer, so a held Button1 can no longer launch or drag
+            iconPressed = false;
+            if (iconDragging)
+            {
+              cancelIconDrag();
+              renderPanel(-1);
+            }
+            showMenuAt(event.xbutton.x_root, event.xbutton.y_root, *currentMenu.texts, currentMenu.itemCount);
             lastClickedPanelIndex = calculateIconIndexFromMouseX(event.xbutton.x, iconCount);
             menuShown = true;
             mouseInsideMenu = true;
           }
+          else if ((event.xbutton.button == Button4 || event.xbutton.button == Button5) && event.xbutton.window == panelWindow)
+          {
+            int step = (layout.iconBoxSize + layout.gapSize) / 2;
+            if (!menuShown && !iconDragging && scrollPanel(event.xbutton.button == Button4 ? -step : step))
+            {
+              hoveredPanelIndex = calculateIconIndexFromMouseX(event.xbutton.x, iconCount);
+              renderPanel(hoveredPanelIndex);
+            }
+          }
           break;
         }
     }
   }
 
+  saveSnapshot();
+  flushHistory();
+  if (catalogChanged) saveCatalog();
+  freeCatalog();
+  freeHistory();
+  freeApplets();
+  freeCandidates();
+  freeIcons();
   freePixelMaps();
+  freeSnapshot();
   freeTexts();
+  freeFont();
   freeXObjects();
   return EXIT_SUCCESS;
 }
@@ -410,19 +1327,69 @@ void initializeColors()
   cIconBackground = calculateRGB(34, 34, 34);
   cIconHover = calculateRGB(51, 51, 51);
   cDialogBackground = calculateRGB(17, 17, 17);
-  cDialogBorder = calculateRGB(139, 212, 156);
+  cDialogForeground = calculateRGB(255, 255, 255);
   cDialogBorder = calculateRGB(139, 212, 156);
 }
 
 void initializeDisplay()
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  display = XOpenDisplay(X_DISPLAY_NAME);
+  const char* displayName = getenv("DISPLAY") != NULL ? NULL : DEFAULT_DISPLAY_NAME;
+  display = XOpenDisplay(displayName);
   if (display == NULL)
   {
-    fprintf(stderr, "Cannot connect to X server: %s!\n", X_DISPLAY_NAME);
+    fprintf(stderr, "Cannot connect to X server: %s!\n", XDisplayName(displayName));
     exit(EXIT_FAILURE);
   }
+
+  const char* remoteSetting = getenv(REMOTE_ENV_NAME);
+  if (remoteSetting != NULL) remoteDisplay = strcmp(remoteSetting, "0") != 0;
+  else remoteDisplay = isRemoteConnection();
+  trafficRequest = NextRequest(display);
+}
+
+void initializeLayout()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  XrmInitialize();
+  calculateLayout(readScale(XResourceManagerString(display)));
+
+  // Follow Xft.dpi changes unless the scale is pinned by the environment
+  if (getenv(SCALE_ENV_NAME) == NULL)
+  {
+    XSelectInput(display, DefaultRootWindow(display), PropertyChangeMask);
+  }
+}
+
+void initializeIconImages()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  const char* setting = getenv(PIXMAP_BUDGET_ENV_NAME);
+  long budget = setting != NULL ? strtol(setting, NULL, 10) : PIXMAP_BUDGET_DEFAULT_KB;
+  if (budget <= 0) budget = PIXMAP_BUDGET_DEFAULT_KB;
+  pixmapBudget = (unsigned long)budget * 1024;
+
+  // Remotely an evicted icon would cross the network again, so every upload stays
+  if (remoteDisplay) pixmapBudget = ULONG_MAX;
+
+  // Pixels are packed once in the server's own format so uploads never convert
+  int screenNum = DefaultScreen(display);
+  packedDepth = DefaultDepth(display, screenNum);
+  packedBitsPerPixel = 32;
+  packedByteOrder = ImageByteOrder(display);
+  int formatCount = 0;
+  XPixmapFormatValues* formats = XListPixmapFormats(display, &formatCount);
+  for (int index = 0; index < formatCount; index++)
+  {
+    if (formats[index].depth == packedDepth) packedBitsPerPixel = formats[index].bits_per_pixel;
+  }
+  if (formats != NULL) XFree(formats);
+}
+
+void initializeText()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  loadFont(layout.scale);
 }
 
 void initilalizeMenuTexts()
@@ -447,8 +1414,8 @@ void initializePanel(int screenNum, int panelX, int panelY, int panelWidth, unsi
     panelX,
     panelY,
     panelWidth,
-    PANEL_HEIGHT,
-    WINDOW_BORDER_WIDTH,
+    layout.panelHeight,
+    layout.borderWidth,
     cBorder,
     cBackground
   );
@@ -457,7 +1424,7 @@ void initializePanel(int screenNum, int panelX, int panelY, int panelWidth, unsi
   XSetWindowAttributes panelAttributes;
   panelAttributes.override_redirect = true;
   XChangeWindowAttributes(display, panelWindow, CWOverrideRedirect, &panelAttributes);
-  XSelectInput(display, panelWindow, ExposureMask | ShiftMask | ButtonPressMask | PointerMotionMask | LeaveWindowMask);
+  XSelectInput(display, panelWindow, ExposureMask | ShiftMask | ButtonPressMask | ButtonReleaseMask | PointerMotionMask | EnterWindowMask | LeaveWindowMask);
 
   if (SHOW_UNDER) XLowerWindow(display, panelWindow);
 }
@@ -470,18 +1437,20 @@ void initializeMenu(int screenNum, unsigned long cBackground, unsigned int cBord
     RootWindow(display, screenNum),
     0,
     0,
-    ITEM_WIDTH,
+    layout.itemWidth,
     100,
-    WINDOW_BORDER_WIDTH,
+    layout.borderWidth,
     cBorder,
     cBackground
   );
   menuGC = XCreateGC(display, menuWindow, 0, 0);
   XSetForeground(display, menuGC, cMenuForeground);
 
+  // Every exposed area is copied from the menu buffer, skip the server clear
   XSetWindowAttributes menuAttributes;
   menuAttributes.override_redirect = true;
-  XChangeWindowAttributes(display, menuWindow, CWOverrideRedirect, &menuAttributes);
+  menuAttributes.background_pixmap = None;
+  XChangeWindowAttributes(display, menuWindow, CWOverrideRedirect | CWBackPixmap, &menuAttributes);
   XSelectInput(display, menuWindow, ExposureMask | ButtonPressMask | PointerMotionMask | EnterWindowMask | LeaveWindowMask);
 }
 
@@ -493,9 +1462,9 @@ void initializeDialog(int screenNum, unsigned long cBackground, unsigned long cB
     RootWindow(display, screenNum),
     16,
     16,
-    400,
-    200,
-    WINDOW_BORDER_WIDTH,
+    scaleDimension(400, layout.scale),
+    scaleDimension(200, layout.scale),
+    layout.borderWidth,
     cBorder,
     cBackground
   );
@@ -506,513 +1475,3555 @@ void initializeDialog(int screenNum, unsigned long cBackground, unsigned long cB
   dialogAttributes.override_redirect = true;
   XChangeWindowAttributes(display, dialogWindow, CWOverrideRedirect, &dialogAttributes);
   XSelectInput(display, dialogWindow, ExposureMask | ButtonPressMask);
+  resizeDialog();
 }
 
-void showPanel()
+void initializeTooltip(struct IconNode* icon, unsigned long cBorder)
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  XMapWindow(display, panelWindow);
-  XClearWindow(display, panelWindow);
-}
+  char text[512];
+  snprintf(text, sizeof(text), "%s\n%s", icon->name, icon->command);
+  icon->tooltip = createTextLabel(text, cMenuForeground, cMenuBackground, 0, 0);
 
-void refreshPanel(int iconCount, int screenWidth, int screenHeight)
-{
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  int panelWidth = calculatePanelWidth(iconCount);
-  XResizeWindow(
-    display,
-    panelWindow,
-    panelWidth,
-    PANEL_HEIGHT
-  );
-  XMoveWindow(
+  // The label is the background from the start, so showing needs only a move and a map
+  int screenNum = DefaultScreen(display);
+  XSetWindowAttributes tooltipAttributes;
+  tooltipAttributes.background_pixmap = icon->tooltip->pixelMap;
+  tooltipAttributes.border_pixel = cBorder;
+  tooltipAttributes.override_redirect = true;
+  icon->tooltipWindow = XCreateWindow(
     display,
-    panelWindow,
-    screenWidth / 2 - panelWidth / 2,
-    screenHeight - PANEL_HEIGHT - PANEL_BOTTOM_OFFSET - WINDOW_BORDER_WIDTH
+    RootWindow(display, screenNum),
+    0,
+    0,
+    icon->tooltip->width,
+    icon->tooltip->height,
+    layout.borderWidth,
+    CopyFromParent,
+    InputOutput,
+    CopyFromParent,
+    CWBackPixmap | CWBorderPixel | CWOverrideRedirect,
+    &tooltipAttributes
   );
-  XClearWindow(display, panelWindow);
 }
 
-void showMenu()
+void initializeFramePacing()
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  XMapWindow(display, menuWindow);
-  grabPointer();
-}
+  const char* setting = getenv(REFRESH_RATE_ENV_NAME);
+  long rate = setting != NULL ? strtol(setting, NULL, 10) : DEFAULT_REFRESH_RATE;
+  if (rate <= 0) rate = DEFAULT_REFRESH_RATE;
+  frameInterval = 1000000 / rate;
 
-void showMenuAt(int x, int y, int itemCount)
-{
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  XResizeWindow(display, menuWindow, ITEM_WIDTH, itemCount * ITEM_HEIGHT);
-  XMoveWindow(display, menuWindow, x, y - itemCount * ITEM_HEIGHT);
-  showMenu();
+  // Remotely each frame is a request, so the panel jumps in a single move
+  slideDuration = remoteDisplay ? 0 : (uint64_t)SLIDE_DURATION_MS * 1000;
 }
 
-void clearMenu()
+void ensureMenuWindow()
 {
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  XClearWindow(display, menuWindow);
+  if (menuWindow != None) return;
+  initializeMenu(DefaultScreen(display), cMenuBackground, cMenuBorder);
 }
 
-void hideMenu()
+void ensureDialogWindow()
 {
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  XUnmapWindow(display, menuWindow);
-  releasePointer();
+  if (dialogWindow != None) return;
+  initializeDialog(DefaultScreen(display), cDialogBackground, cDialogBorder);
 }
 
-void showDialog()
+void ensureTooltipWindow(struct IconNode* icon)
 {
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  XMapWindow(display, dialogWindow);
-  XClearWindow(display, dialogWindow);
+  if (icon->tooltipWindow != None) return;
+  initializeTooltip(icon, cMenuBorder);
 }
 
-void hideDialog()
+void parseArguments(int argc, char** argv)
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  XUnmapWindow(display, dialogWindow);
-  releasePointer();
+  for (int index = 1; index < argc; index++)
+  {
+    if (strcmp(argv[index], "--trace-startup") == 0)
+    {
+      traceStartup = true;
+    }
+    else if (strcmp(argv[index], "--trace-traffic") == 0)
+    {
+      traceTraffic = true;
+    }
+    else if (strcmp(argv[index], "--soak-test") == 0)
+    {
+      soakCycles = index + 1 < argc ? atoi(argv[++index]) : 0;
+      if (soakCycles <= 0)
+      {
+        fprintf(stderr, "Cannot run soak test: expected a positive cycle count!\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    else
+    {
+      fprintf(stderr, "Unknown option: %s!\n", argv[index]);
+      exit(EXIT_FAILURE);
+    }
+  }
 }
 
-void grabPointer()
+void traceStartupPhase(const char* phase)
 {
-  XGrabPointer(
+  if (!traceStartup) return;
+  printf("%9.3f ms  %s\n", (currentTime() - startupTime) / 1000.0, phase);
+  fflush(stdout);
+}
+
+bool isRemoteConnection()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // Local servers are reached through a Unix socket, TCP (even to localhost) means forwarding or a real network
+  struct sockaddr_storage address;
+  socklen_t size = sizeof(address);
+  if (getsockname(ConnectionNumber(display), (struct sockaddr*)&address, &size) != 0) return false;
+  return address.ss_family != AF_UNIX;
+}
+
+void noteRoundTrips(int count)
+{
+  roundTripCount += count;
+}
+
+bool readConnectionBytes(uint64_t* bytesOut, uint64_t* bytesIn)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  // Written bytes are the acknowledged ones plus whatever still waits in the send queue
+  struct tcp_info info;
+  socklen_t size = sizeof(info);
+  int connection = ConnectionNumber(display);
+  if (getsockopt(connection, IPPROTO_TCP, TCP_INFO, &info, &size) != 0) return false;
+  if (size < offsetof(struct tcp_info, tcpi_bytes_received) + sizeof(info.tcpi_bytes_received)) return false;
+  int queued = 0;
+  if (ioctl(connection, SIOCOUTQ, &queued) != 0) queued = 0;
+  *bytesOut = info.tcpi_bytes_acked + (uint64_t)queued;
+  *bytesIn = info.tcpi_bytes_received;
+  return true;
+}
+
+void beginTrafficInteraction(const char* label)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  reportTraffic();
+  trafficLabel = label;
+}
+
+void reportTraffic()
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  // Idle passes that sent nothing are folded into the next interaction silently
+  XFlush(display);
+  unsigned long request = NextRequest(display);
+  uint64_t bytesOut = 0;
+  uint64_t bytesIn = 0;
+  bool haveBytes = readConnectionBytes(&bytesOut, &bytesIn);
+  unsigned long requests = request - trafficRequest;
+  int roundTrips = roundTripCount - trafficRoundTrips;
+  if (requests > 0 || roundTrips > 0)
+  {
+    const char* label = trafficLabel != NULL ? trafficLabel : "background";
+    if (haveBytes)
+    {
+      printf(
+        "%-16s %5lu requests %3d round trips %8llu bytes out %8llu bytes in\n",
+        label,
+        requests,
+        roundTrips,
+        (unsigned long long)(bytesOut - trafficBytesOut),
+        (unsigned long long)(bytesIn - trafficBytesIn)
+      );
+    }
+    else
+    {
+      printf("%-16s %5lu requests %3d round trips\n", label, requests, roundTrips);
+    }
+    fflush(stdout);
+  }
+  trafficLabel = NULL;
+  trafficRequest = request;
+  trafficRoundTrips = roundTripCount;
+  trafficBytesOut = bytesOut;
+  trafficBytesIn = bytesIn;
+}
+
+const char* describeInteraction(int timer, XEvent* event)
+{
+  switch (timer)
+  {
+    case TIMER_TOOLTIP: return "tooltip delay";
+    case TIMER_AUTO_HIDE: return "auto-hide delay";
+    case TIMER_FRAME: return "slide frame";
+    case TIMER_DRAG_FRAME: return "drag frame";
+    case TIMER_HISTORY_FLUSH: return "history flush";
+    case TIMER_APPLET: return "applet tick";
+    case TIMER_SNAPSHOT_SAVE: return "snapshot save";
+  }
+  switch (event->type)
+  {
+    case Expose: return "Expose";
+    case MotionNotify: return "MotionNotify";
+    case PropertyNotify: return "PropertyNotify";
+    case KeyPress: return "KeyPress";
+    case ButtonPress: return "ButtonPress";
+    case ButtonRelease: return "ButtonRelease";
+    case EnterNotify: return "EnterNotify";
+    case LeaveNotify: return "LeaveNotify";
+  }
+  return "other event";
+}
+
+void initializeAutoHide(int screenNum, int screenWidth, int screenHeight)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // Invisible strip along the bottom edge, mapped only while the panel is hidden
+  XSetWindowAttributes triggerAttributes;
+  triggerAttributes.override_redirect = true;
+  triggerAttributes.event_mask = EnterWindowMask;
+  triggerWindow = XCreateWindow(
     display,
-    menuWindow,
-    false,
-    ButtonPressMask | ButtonReleaseMask | PointerMotionMask | EnterWindowMask | LeaveWindowMask,
-    GrabModeAsync,
-    GrabModeAsync,
-    None,
-    None,
-    CurrentTime
+    RootWindow(display, screenNum),
+    0,
+    screenHeight - layout.triggerHeight,
+    screenWidth,
+    layout.triggerHeight,
+    0,
+    0,
+    InputOnly,
+    CopyFromParent,
+    CWOverrideRedirect | CWEventMask,
+    &triggerAttributes
   );
 }
 
-void releasePointer()
+void showPanel()
 {
-  XUngrabPointer(display, CurrentTime);
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  XMapWindow(display, panelWindow);
+  XClearWindow(display, panelWindow);
 }
 
-void renderIconAtIndex(int index)
+void refreshPanel(int iconCount, int screenWidth, int screenHeight)
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  int iconX = index * (ICON_BOX_SIZE + GAP_SIZE) + GAP_SIZE;
-  int iconY = GAP_SIZE;
-  XSetForeground(display, panelGC, cIconBackground);
-  XFillRectangle(
+  panelIconAreaWidth = calculatePanelWidth(calculateVisibleIconCount(iconCount, screenWidth));
+  int panelWidth = layoutApplets(panelIconAreaWidth);
+  panelX = screenWidth / 2 - panelWidth / 2;
+  panelY = screenHeight - layout.panelHeight - layout.panelBottomOffset - layout.borderWidth;
+  if (panelSliding)
+  {
+    disarmTimer(TIMER_FRAME);
+    panelSliding = false;
+    if (panelHidden) XMapRaised(display, triggerWindow);
+  }
+  panelCurrentY = panelHidden ? calculateHiddenPanelY() : panelY;
+  XMoveResizeWindow(
     display,
     panelWindow,
-    panelGC,
-    iconX,
-    iconY,
-    ICON_BOX_SIZE,
-    ICON_BOX_SIZE
+    panelX,
+    panelCurrentY,
+    panelWidth,
+    layout.panelHeight
   );
+
+  if (panelBuffer != None) XFreePixmap(display, panelBuffer);
+  panelBuffer = XCreatePixmap(display, panelWindow, panelWidth, layout.panelHeight, DefaultDepth(display, DefaultScreen(display)));
+  panelBufferWidth = panelWidth;
+  panelContentWidth = calculatePanelWidth(iconCount);
+  scrollPanel(0);
+  renderPanel(-1);
 }
 
-void renderIconHoverAtIndex(int index)
+void showMenu()
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  int hoverX = index * (ICON_BOX_SIZE + GAP_SIZE) + GAP_SIZE;
-  int hoverY = GAP_SIZE;
-  XSetForeground(display, panelGC, cIconHover);
-  XFillRectangle(
+  XMapWindow(display, menuWindow);
+  grabPointer();
+}
+
+void showMenuAt(int x, int y, const char** menuItems, int itemCount)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  ensureMenuWindow();
+  composeMenuBuffer(menuItems, itemCount);
+  XMoveResizeWindow(
     display,
-    panelWindow,
-    panelGC,
-    hoverX,
-    hoverY,
-    ICON_BOX_SIZE,
-    ICON_BOX_SIZE
+    menuWindow,
+    x,
+    y - itemCount * layout.itemHeight,
+    layout.itemWidth,
+    itemCount * layout.itemHeight
   );
-  XSetForeground(display, panelGC, cIconBackground);
+  showMenu();
 }
 
-void renderIcons()
+void hideMenu()
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  XClearWindow(display, panelWindow);
+  XUnmapWindow(display, menuWindow);
+  releasePointer();
+}
 
-  if (iconList == NULL) return;
-  struct IconNode* current = iconList;
-  int index = 0;
-  while (current != NULL)
+void showDialog(int mode)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // After the first use window, buffer and candidates stay, showing only filters and maps
+  ensureDialogWindow();
+  dialogMode = mode;
+  dialogQuery[0] = '\0';
+  dialogQueryLength = 0;
+  rewatchPathDirectories();
+  filterCandidates();
+  renderDialog();
+
+  int screenNum = DefaultScreen(display);
+  int dialogX = (DisplayWidth(display, screenNum) - dialogWidth) / 2 - layout.borderWidth;
+  int dialogY = DisplayHeight(display, screenNum) / 3 - dialogHeight / 2;
+  XMoveWindow(display, dialogWindow, dialogX, dialogY);
+  XMapRaised(display, dialogWindow);
+
+  // Another client may still hold the keyboard for a moment, without the grab typing goes elsewhere
+  int grabResult = XGrabKeyboard(display, dialogWindow, False, GrabModeAsync, GrabModeAsync, CurrentTime);
+  noteRoundTrips(1);
+  for (int attempt = 1; attempt < GRAB_ATTEMPTS && grabResult != GrabSuccess; attempt++)
   {
-    renderIconAtIndex(index);
-    index++;
-    current = current->next;
+    usleep(GRAB_RETRY_MS * 1000);
+    grabResult = XGrabKeyboard(display, dialogWindow, False, GrabModeAsync, GrabModeAsync, CurrentTime);
+    noteRoundTrips(1);
+  }
+  if (grabResult != GrabSuccess)
+  {
+    fprintf(stderr, "Cannot grab keyboard for the launcher: %d!\n", grabResult);
+    XUnmapWindow(display, dialogWindow);
+    return;
   }
+  dialogShown = true;
 }
 
-void renderIconPixelMapAtIndex(int index)
+void hideDialog()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  XUnmapWindow(display, dialogWindow);
+  XUngrabKeyboard(display, CurrentTime);
+  dialogShown = false;
+}
+
+void showTooltipAtIndex(int index)
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
   struct IconNode* icon = getIconByIndex(index);
   if (icon == NULL) return;
-  int iconX = index * (ICON_BOX_SIZE + GAP_SIZE) + GAP_SIZE + ICON_INSET;
-  XSetClipMask(display, panelGC, icon->mask);
-  XSetClipOrigin(display, panelGC, iconX, GAP_SIZE + ICON_INSET);
-  XCopyArea(display, icon->pixelMap, panelWindow, panelGC, 0, 0, ICON_SIZE, ICON_SIZE, iconX, GAP_SIZE + ICON_INSET);
-  XSetClipMask(display, panelGC, None);
+  // Each icon renders its tooltip once and keeps it out of the shared label cache
+  ensureTooltipWindow(icon);
+  struct TextLabel* label = icon->tooltip;
+
+  int screenWidth = DisplayWidth(display, DefaultScreen(display));
+  int tooltipX = panelX + layout.borderWidth + calculateIconX(index) + layout.iconBoxSize / 2 - label->width / 2;
+  int tooltipY = panelY - label->height - 2 * layout.borderWidth - layout.gapSize;
+  if (tooltipX + label->width + 2 * layout.borderWidth > screenWidth) tooltipX = screenWidth - label->width - 2 * layout.borderWidth;
+  if (tooltipX < 0) tooltipX = 0;
+
+  // The server paints the background itself, a move and a map are all it takes
+  XMoveWindow(display, icon->tooltipWindow, tooltipX, tooltipY);
+  if (tooltipShown && tooltipWindow == icon->tooltipWindow) return;
+  XMapRaised(display, icon->tooltipWindow);
+  if (tooltipShown) XUnmapWindow(display, tooltipWindow);
+  tooltipWindow = icon->tooltipWindow;
+  tooltipShown = true;
+}
+
+void hideTooltip()
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  disarmTimer(TIMER_TOOLTIP);
+  if (!tooltipShown) return;
+  XUnmapWindow(display, tooltipWindow);
+  tooltipShown = false;
 }
 
-void renderIconPixelMaps(struct IconNode* iconList)
+void initializeHotkey()
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  if (iconList == NULL) return;
+  // Caps Lock and Num Lock must not stop the hotkey, so every combination is grabbed
+  KeyCode keycode = XKeysymToKeycode(display, HOTKEY_KEYSYM);
+  const unsigned int lockMasks[] = { 0, LockMask, Mod2Mask, LockMask | Mod2Mask };
+  if (keycode == 0) return;
 
-  struct IconNode* current = iconList;
-  int index = 0;
+  // Another client holding the combination answers with BadAccess, which would otherwise end the panel
+  hotkeyGrabDenied = false;
+  XSync(display, False);
+  int (*previousHandler)(Display*, XErrorEvent*) = XSetErrorHandler(catchGrabError);
+  for (int index = 0; index < 4; index++)
+  {
+    XGrabKey(display, keycode, HOTKEY_MODIFIERS | lockMasks[index], DefaultRootWindow(display), False, GrabModeAsync, GrabModeAsync);
+  }
+  XSync(display, False);
+  noteRoundTrips(2);
+  if (hotkeyGrabDenied)
+  {
+    fprintf(stderr, "Cannot grab hotkey: another client already holds it!\n");
+    for (int index = 0; index < 4; index++)
+    {
+      XUngrabKey(display, keycode, HOTKEY_MODIFIERS | lockMasks[index], DefaultRootWindow(display));
+    }
+  }
+  XSetErrorHandler(previousHandler);
+}
 
-  while (current != NULL)
+int catchGrabError(Display* errorDisplay, XErrorEvent* error)
+{
+  (void)errorDisplay;
+  if (error->error_code == BadAccess) hotkeyGrabDenied = true;
+  return 0;
+}
+
+void loadApplications()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  char path[PATH_MAX];
+  const char* dataHome = getenv("XDG_DATA_HOME");
+  const char* home = getenv("HOME");
+  if (dataHome != NULL && dataHome[0] == '/') snprintf(path, sizeof(path), "%s/applications", dataHome);
+  else if (home != NULL) snprintf(path, sizeof(path), "%s/.local/share/applications", home);
+  else path[0] = '\0';
+  if (path[0] != '\0') loadApplicationDirectory(path);
+
+  const char* dataDirs = getenv("XDG_DATA_DIRS");
+  if (dataDirs == NULL || dataDirs[0] == '\0') dataDirs = DEFAULT_DATA_DIRS;
+  while (*dataDirs != '\0')
+  {
+    size_t length = strcspn(dataDirs, ":");
+    if (length > 0 && length < sizeof(path) - 16)
+    {
+      snprintf(path, sizeof(path), "%.*s/applications", (int)length, dataDirs);
+      loadApplicationDirectory(path);
+    }
+    dataDirs += length;
+    if (*dataDirs == ':') dataDirs++;
+  }
+}
+
+void loadApplicationDirectory(const char* path)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  DIR* directory = opendir(path);
+  if (directory == NULL) return;
+  struct dirent* entry;
+  char filePath[PATH_MAX];
+  while ((entry = readdir(directory)) != NULL)
+  {
+    size_t length = strlen(entry->d_name);
+    if (length < 8 || strcmp(entry->d_name + length - 8, ".desktop") != 0) continue;
+    snprintf(filePath, sizeof(filePath), "%s/%s", path, entry->d_name);
+    loadApplicationFile(filePath);
+  }
+  closedir(directory);
+}
+
+void loadApplicationFile(const char* path)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  FILE* file = fopen(path, "r");
+  if (file == NULL) return;
+
+  char line[1024];
+  char name[256] = "";
+  char command[1024] = "";
+  bool inEntry = false;
+  bool application = false;
+  bool hidden = false;
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '[')
+    {
+      inEntry = strcmp(line, "[Desktop Entry]") == 0;
+      continue;
+    }
+    if (!inEntry) continue;
+    if (strncmp(line, "Name=", 5) == 0 && name[0] == '\0') snprintf(name, sizeof(name), "%.*s", (int)sizeof(name) - 1, line + 5);
+    else if (strncmp(line, "Exec=", 5) == 0 && command[0] == '\0') snprintf(command, sizeof(command), "%s", line + 5);
+    else if (strcmp(line, "Type=Application") == 0) application = true;
+    else if (strcmp(line, "NoDisplay=true") == 0 || strcmp(line, "Hidden=true") == 0) hidden = true;
+  }
+  fclose(file);
+  if (!application || hidden || name[0] == '\0' || command[0] == '\0') return;
+
+  // Field codes such as %U are dropped, %% stays a literal percent sign
+  char* target = command;
+  for (const char* cursor = command; *cursor != '\0'; cursor++)
+  {
+    if (*cursor != '%')
+    {
+      *target++ = *cursor;
+      continue;
+    }
+    if (cursor[1] == '%') *target++ = '%';
+    if (cursor[1] != '\0') cursor++;
+  }
+  while (target > command && target[-1] == ' ') target--;
+  *target = '\0';
+
+  if (applicationCandidateCount == applicationCandidateCapacity)
+  {
+    applicationCandidateCapacity = applicationCandidateCapacity == 0 ? 64 : applicationCandidateCapacity * 2;
+    applicationCandidates = (struct Candidate*)realloc(applicationCandidates, applicationCandidateCapacity * sizeof(struct Candidate));
+  }
+  struct Candidate* candidate = &applicationCandidates[applicationCandidateCount++];
+  candidate->name = internString(name, ICON_NAME_LIMIT);
+  candidate->command = internString(command, INTERNED_STRING_LIMIT);
+  candidate->pinned = false;
+  candidate->score = 0;
+  candidate->frecency = 0.0;
+}
+
+void filterCandidates()
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  dialogMatchCount = 0;
+  dialogSelection = 0;
+  int64_t now = time(NULL);
+  for (unsigned int index = 0; index < iconTableCount; index++)
+  {
+    considerCandidate(iconTable[index]->name, iconTable[index]->command, true, now);
+  }
+  for (int index = 0; index < applicationCandidateCount; index++)
+  {
+    considerCandidate(applicationCandidates[index].name, applicationCandidates[index].command, false, now);
+  }
+  matchCatalog(now);
+}
+
+void considerCandidate(const char* name, const char* command, bool pinned, int64_t now)
+{
+  // Lower scores rank first: name prefix, name substring, then command substring
+  int score;
+  if (dialogQueryLength == 0 || strncasecmp(name, dialogQuery, dialogQueryLength) == 0) score = 0;
+  else if (strcasestr(name, dialogQuery) != NULL) score = 1;
+  else if (strcasestr(command, dialogQuery) != NULL) score = 2;
+  else return;
+  insertCandidate(name, command, pinned, score, now);
+}
+
+void insertCandidate(const char* name, const char* command, bool pinned, int score, int64_t now)
+{
+  // A full list only takes entries that can outrank its last row, a command already listed is skipped
+  if (dialogMatchCount == DIALOG_ROW_LIMIT && dialogMatches[DIALOG_ROW_LIMIT - 1].score < score) return;
+  for (int index = 0; index < dialogMatchCount; index++)
+  {
+    if (strcmp(dialogMatches[index].command, command) == 0) return;
+  }
+  double frecency = readFrecency(command, now);
+
+  // Within a score frecency decides, pinned entries win ties and the rest keep source order
+  int position = dialogMatchCount;
+  while (position > 0)
+  {
+    struct Candidate* previous = &dialogMatches[position - 1];
+    if (previous->score < score) break;
+    if (previous->score == score && previous->frecency > frecency) break;
+    if (previous->score == score && previous->frecency == frecency && (previous->pinned || !pinned)) break;
+    position--;
+  }
+  if (position >= DIALOG_ROW_LIMIT) return;
+  int last = dialogMatchCount < DIALOG_ROW_LIMIT ? dialogMatchCount : DIALOG_ROW_LIMIT - 1;
+  memmove(&dialogMatches[position + 1], &dialogMatches[position], (last - position) * sizeof(struct Candidate));
+  dialogMatches[position].name = name;
+  dialogMatches[position].command = command;
+  dialogMatches[position].pinned = pinned;
+  dialogMatches[position].score = score;
+  dialogMatches[position].frecency = frecency;
+  if (dialogMatchCount < DIALOG_ROW_LIMIT) dialogMatchCount++;
+}
+
+void renderDialog()
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  XSetForeground(display, dialogGC, cDialogBackground);
+  XFillRectangle(display, dialogBuffer, dialogGC, 0, 0, dialogWidth, dialogHeight);
+
+  char prompt[DIALOG_QUERY_LIMIT + 16];
+  snprintf(prompt, sizeof(prompt), "%s %s_", dialogMode == DIALOG_MODE_ADD_ITEM ? "Add:" : "Run:", dialogQuery);
+  struct TextLabel* label = getTextLabel(prompt, cDialogForeground, cDialogBackground, dialogWidth, layout.itemHeight);
+  XCopyArea(display, label->pixelMap, dialogBuffer, dialogGC, 0, 0, label->width, label->height, 0, 0);
+
+  for (int index = 0; index < dialogMatchCount; index++)
+  {
+    unsigned long background = index == dialogSelection ? cMenuHover : cDialogBackground;
+    label = getTextLabel(dialogMatches[index].name, cMenuForeground, background, dialogWidth, layout.itemHeight);
+    XCopyArea(display, label->pixelMap, dialogBuffer, dialogGC, 0, 0, label->width, label->height, 0, (index + 1) * layout.itemHeight);
+  }
+
+  // The buffer is the window background, so clearing repaints it without an Expose
+  XClearWindow(display, dialogWindow);
+}
+
+void resizeDialog()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  dialogWidth = scaleDimension(DIALOG_WIDTH, layout.scale);
+  dialogHeight = (DIALOG_ROW_LIMIT + 1) * layout.itemHeight;
+  XResizeWindow(display, dialogWindow, dialogWidth, dialogHeight);
+  if (dialogBuffer != None) XFreePixmap(display, dialogBuffer);
+  dialogBuffer = XCreatePixmap(display, dialogWindow, dialogWidth, dialogHeight, DefaultDepth(display, DefaultScreen(display)));
+  XSetWindowBackgroundPixmap(display, dialogWindow, dialogBuffer);
+}
+
+struct Candidate* handleDialogKey(XKeyEvent* event)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  char text[16];
+  KeySym keysym = NoSymbol;
+  int length = XLookupString(event, text, sizeof(text), &keysym, NULL);
+
+  if (keysym == HOTKEY_KEYSYM && (event->state & HOTKEY_MODIFIERS) == HOTKEY_MODIFIERS)
+  {
+    hideDialog();
+    return NULL;
+  }
+  switch (keysym)
+  {
+    case XK_Escape:
+      hideDialog();
+      return NULL;
+    case XK_Return:
+    case XK_KP_Enter:
+      return dialogMatchCount > 0 ? &dialogMatches[dialogSelection] : NULL;
+    case XK_Up:
+      if (dialogSelection > 0) dialogSelection--;
+      break;
+    case XK_Down:
+    case XK_Tab:
+      if (dialogSelection < dialogMatchCount - 1) dialogSelection++;
+      break;
+    case XK_BackSpace:
+      if (dialogQueryLength == 0) return NULL;
+      dialogQuery[--dialogQueryLength] = '\0';
+      filterCandidates();
+      break;
+    default:
+      if (length != 1 || !isprint((unsigned char)text[0]) || dialogQueryLength >= DIALOG_QUERY_LIMIT - 1) return NULL;
+      dialogQuery[dialogQueryLength++] = text[0];
+      dialogQuery[dialogQueryLength] = '\0';
+      filterCandidates();
+      break;
+  }
+  renderDialog();
+  return NULL;
+}
+
+void launchCommand(const char* command)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // The shell puts the program in the background, so system returns right away
+  char line[INTERNED_STRING_LIMIT + 32];
+  snprintf(line, sizeof(line), "cd $HOME && %s &", command);
+  system(line);
+  recordLaunch(command);
+}
+
+void loadHistory()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  char path[PATH_MAX];
+  if (!resolveStatePath(path, sizeof(path), "XDG_DATA_HOME", ".local/share", HISTORY_FILE_NAME)) return;
+  historyFile = open(path, O_RDWR | O_APPEND | O_CREAT, 0644);
+  if (historyFile < 0) return;
+
+  // The whole log is read with one call and parsed in place
+  struct stat status;
+  if (fstat(historyFile, &status) != 0) return;
+  size_t size = status.st_size;
+  char* data = (char*)malloc(size + 1);
+  size_t loaded = 0;
+  while (loaded < size)
+  {
+    ssize_t count = pread(historyFile, data + loaded, size - loaded, loaded);
+    if (count <= 0) break;
+    loaded += count;
+  }
+
+  size_t offset = sizeof(HISTORY_MAGIC);
+  if (size == 0)
+  {
+    // A new file starts with a fresh header
+    offset = 0;
+  }
+  else if (loaded < offset || memcmp(data, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != 0)
+  {
+    // Foreign, future or half written files are set aside rather than overwritten
+    free(data);
+    close(historyFile);
+    historyFile = -1;
+    char asidePath[PATH_MAX + 8];
+    snprintf(asidePath, sizeof(asidePath), "%s.bad", path);
+    if (rename(path, asidePath) != 0)
+    {
+      fprintf(stderr, "Cannot read history, leaving it untouched: %s!\n", path);
+      return;
+    }
+    fprintf(stderr, "Cannot read history, moved it to %s!\n", asidePath);
+    loadHistory();
+    return;
+  }
+  else
+  {
+    char command[INTERNED_STRING_LIMIT];
+    while (offset + sizeof(struct HistoryRecord) <= loaded)
+    {
+      const struct HistoryRecord* record = (const struct HistoryRecord*)(data + offset);
+      size_t recordSize = calculateHistoryRecordSize(record->commandLength);
+      if (
+        record->commandLength == 0 || record->commandLength >= sizeof(command) ||
+        offset + recordSize > loaded ||
+        calculateHistoryChecksum(record, data + offset + sizeof(struct HistoryRecord)) != record->checksum
+      )
+      {
+        break;
+      }
+      memcpy(command, data + offset + sizeof(struct HistoryRecord), record->commandLength);
+      command[record->commandLength] = '\0';
+      mergeHistoryRecord(command, record->time, record->score, record->launchCount);
+      historyRecordCount++;
+      offset += recordSize;
+    }
+  }
+  free(data);
+
+  // A torn tail from a crash is cut off so new records follow the last good one
+  if (offset < size && loaded == size && ftruncate(historyFile, offset) != 0) offset = size;
+  if (offset == 0 && write(historyFile, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != (ssize_t)sizeof(HISTORY_MAGIC))
+  {
+    fprintf(stderr, "Cannot write history: %s!\n", path);
+  }
+  if (historyRecordCount > 2 * historyEntryCount + HISTORY_COMPACT_SLACK) armTimer(TIMER_HISTORY_FLUSH, HISTORY_FLUSH_DELAY_MS * 1000);
+}
+
+struct HistoryEntry* mergeHistoryRecord(const char* command, int64_t launchTime, double score, uint32_t launchCount)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  const char* interned = internString(command, INTERNED_STRING_LIMIT);
+  struct HistoryEntry* entry = getHistoryEntry(interned);
+  if (entry != NULL)
+  {
+    releaseString(interned);
+  }
+  else
+  {
+    unsigned int bucket = ((uintptr_t)interned >> 4) % HISTORY_BUCKET_COUNT;
+    entry = (struct HistoryEntry*)allocateFromArena(sizeof(struct HistoryEntry));
+    entry->command = interned;
+    entry->score = 0.0;
+    entry->referenceTime = launchTime;
+    entry->launchCount = 0;
+    entry->next = historyBuckets[bucket];
+    historyBuckets[bucket] = entry;
+    historyEntryCount++;
+  }
+
+  // The stored score is valid at its reference time, decay it up to the new one
+  if (launchTime > entry->referenceTime)
+  {
+    entry->score = decayFrecency(entry->score, entry->referenceTime, launchTime);
+    entry->referenceTime = launchTime;
+  }
+  entry->score += score;
+  entry->launchCount += launchCount;
+  return entry;
+}
+
+struct HistoryEntry* getHistoryEntry(const char* command)
+{
+  // Commands are interned, so the pointer identifies the string
+  unsigned int bucket = ((uintptr_t)command >> 4) % HISTORY_BUCKET_COUNT;
+  for (struct HistoryEntry* entry = historyBuckets[bucket]; entry != NULL; entry = entry->next)
+  {
+    if (entry->command == command) return entry;
+  }
+  return NULL;
+}
+
+double readFrecency(const char* command, int64_t now)
+{
+  // Catalog names are not interned, so the key is looked up by its text first
+  const char* interned = findInternedString(command);
+  if (interned == NULL) return 0.0;
+  struct HistoryEntry* entry = getHistoryEntry(interned);
+  if (entry == NULL) return 0.0;
+  return decayFrecency(entry->score, entry->referenceTime, now);
+}
+
+double decayFrecency(double score, int64_t from, int64_t to)
+{
+  if (to <= from) return score;
+  return score * exp2(-(double)(to - from) / (HISTORY_HALF_LIFE_DAYS * 86400.0));
+}
+
+void recordLaunch(const char* command)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  int64_t now = time(NULL);
+  mergeHistoryRecord(command, now, 1.0, 1);
+  appendHistoryRecord(command, now, 1.0, 1, &historyPending, &historyPendingSize, &historyPendingCapacity);
+  historyRecordCount++;
+
+  // The record only reaches the file once the loop is idle
+  if (timerDeadlines[TIMER_HISTORY_FLUSH] == 0) armTimer(TIMER_HISTORY_FLUSH, HISTORY_FLUSH_DELAY_MS * 1000);
+}
+
+void appendHistoryRecord(const char* command, int64_t launchTime, double score, uint32_t launchCount, char** buffer, size_t* size, size_t* capacity)
+{
+  static const char padding[8];
+  struct HistoryRecord record;
+  memset(&record, 0, sizeof(record));
+  record.commandLength = strlen(command);
+  record.launchCount = launchCount;
+  record.time = launchTime;
+  record.score = score;
+  record.checksum = calculateHistoryChecksum(&record, command);
+  appendHistoryBytes(&record, sizeof(record), buffer, size, capacity);
+  appendHistoryBytes(command, record.commandLength, buffer, size, capacity);
+  appendHistoryBytes(padding, calculateHistoryRecordSize(record.commandLength) - sizeof(record) - record.commandLength, buffer, size, capacity);
+}
+
+size_t calculateHistoryRecordSize(size_t commandLength)
+{
+  return (sizeof(struct HistoryRecord) + commandLength + 7) & ~(size_t)7;
+}
+
+uint32_t calculateHistoryChecksum(const struct HistoryRecord* record, const char* command)
+{
+  // FNV-1a over everything after the checksum field, then over the command
+  uint32_t hash = 2166136261u;
+  const unsigned char* bytes = (const unsigned char*)record;
+  for (size_t i = sizeof(record->checksum); i < sizeof(struct HistoryRecord); i++) hash = (hash ^ bytes[i]) * 16777619u;
+  for (size_t i = 0; i < record->commandLength; i++) hash = (hash ^ (unsigned char)command[i]) * 16777619u;
+  return hash;
+}
+
+void flushHistory()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (historyFile < 0) return;
+  if (historyCompactor > 0) finishHistoryCompaction(false);
+  if (historyPendingSize > 0)
+  {
+    // A single append that a crash can only leave torn at the end
+    if (write(historyFile, historyPending, historyPendingSize) != (ssize_t)historyPendingSize)
+    {
+      fprintf(stderr, "Cannot append to history!\n");
+    }
+    // The running compaction does not know about these records yet
+    if (historyCompactor > 0) appendHistoryBytes(historyPending, historyPendingSize, &historyCarry, &historyCarrySize, &historyCarryCapacity);
+    historyPendingSize = 0;
+  }
+  if (historyCompactor < 0 && historyRecordCount > 2 * historyEntryCount + HISTORY_COMPACT_SLACK) compactHistory();
+}
+
+void compactHistory()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  char path[PATH_MAX];
+  char temporaryPath[PATH_MAX + 8];
+  if (!resolveStatePath(path, sizeof(path), "XDG_DATA_HOME", ".local/share", HISTORY_FILE_NAME)) return;
+  snprintf(temporaryPath, sizeof(temporaryPath), "%s.new", path);
+
+  // Every command collapses into one record holding its score at its reference time
+  size_t size = 0;
+  size_t capacity = 0;
+  char* buffer = NULL;
+  appendHistoryBytes(HISTORY_MAGIC, sizeof(HISTORY_MAGIC), &buffer, &size, &capacity);
+  for (int bucket = 0; bucket < HISTORY_BUCKET_COUNT; bucket++)
+  {
+    for (struct HistoryEntry* entry = historyBuckets[bucket]; entry != NULL; entry = entry->next)
+    {
+      appendHistoryRecord(entry->command, entry->referenceTime, entry->score, entry->launchCount, &buffer, &size, &capacity);
+    }
+  }
+
+  // The write and fsync happen in a child so a slow disk never stalls the event loop
+  pid_t child = fork();
+  if (child == 0)
+  {
+    int file = open(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool written = file >= 0 && write(file, buffer, size) == (ssize_t)size && fsync(file) == 0;
+    _exit(written ? 0 : 1);
+  }
+  free(buffer);
+  if (child < 0)
+  {
+    fprintf(stderr, "Cannot fork history compaction: %s!\n", temporaryPath);
+    return;
+  }
+
+  historyCompactor = child;
+  historyCompactedRecordCount = historyEntryCount;
+  historyForkRecordCount = historyRecordCount;
+  historyCarrySize = 0;
+  armTimer(TIMER_HISTORY_FLUSH, HISTORY_FLUSH_DELAY_MS * 1000);
+}
+
+void finishHistoryCompaction(bool block)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  int status = 0;
+  pid_t result = waitpid(historyCompactor, &status, block ? 0 : WNOHANG);
+  if (result == 0)
+  {
+    // Still writing, look again on the next flush
+    armTimer(TIMER_HISTORY_FLUSH, HISTORY_FLUSH_DELAY_MS * 1000);
+    return;
+  }
+  historyCompactor = -1;
+
+  char path[PATH_MAX];
+  char temporaryPath[PATH_MAX + 8];
+  if (!resolveStatePath(path, sizeof(path), "XDG_DATA_HOME", ".local/share", HISTORY_FILE_NAME)) return;
+  snprintf(temporaryPath, sizeof(temporaryPath), "%s.new", path);
+  bool written = result > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (!written || rename(temporaryPath, path) != 0)
+  {
+    fprintf(stderr, "Cannot compact history: %s!\n", temporaryPath);
+    unlink(temporaryPath);
+    historyCarrySize = 0;
+    return;
+  }
+
+  // Records appended to the old file while the child ran move over to the new one
+  close(historyFile);
+  historyFile = open(path, O_WRONLY | O_APPEND);
+  if (historyFile >= 0 && historyCarrySize > 0 && write(historyFile, historyCarry, historyCarrySize) != (ssize_t)historyCarrySize)
+  {
+    fprintf(stderr, "Cannot append to history!\n");
+  }
+  historyCarrySize = 0;
+  historyRecordCount = historyCompactedRecordCount + historyRecordCount - historyForkRecordCount;
+}
+
+void appendHistoryBytes(const void* bytes, size_t length, char** buffer, size_t* size, size_t* capacity)
+{
+  while (*size + length > *capacity)
+  {
+    *capacity = *capacity == 0 ? 4096 : *capacity * 2;
+    *buffer = (char*)realloc(*buffer, *capacity);
+  }
+  memcpy(*buffer + *size, bytes, length);
+  *size += length;
+}
+
+bool autoPinCommand(const char* name, const char* command)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  for (unsigned int index = 0; index < iconTableCount; index++)
+  {
+    if (strcmp(iconTable[index]->command, command) == 0) return false;
+  }
+
+  // Only commands ranked among the top few and used often enough are pinned
+  int64_t now = time(NULL);
+  double frecency = readFrecency(command, now);
+  if (frecency < AUTO_PIN_MIN_FRECENCY) return false;
+  int higherCount = 0;
+  for (int bucket = 0; bucket < HISTORY_BUCKET_COUNT; bucket++)
+  {
+    for (struct HistoryEntry* entry = historyBuckets[bucket]; entry != NULL; entry = entry->next)
+    {
+      if (decayFrecency(entry->score, entry->referenceTime, now) > frecency) higherCount++;
+    }
+  }
+  if (higherCount >= AUTO_PIN_COUNT) return false;
+  addIcon(name, command);
+  return true;
+}
+
+void loadCatalog()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  const char* searchPath = getenv("PATH");
+  if (searchPath == NULL || searchPath[0] == '\0') searchPath = DEFAULT_PATH;
+  int capacity = 0;
+  while (*searchPath != '\0')
+  {
+    // Relative entries depend on the working directory and repeated ones add nothing
+    size_t length = strcspn(searchPath, ":");
+    if (length > 0 && searchPath[0] == '/' && getPathDirectoryByPath(searchPath, length) == NULL)
+    {
+      if (pathDirectoryCount == capacity)
+      {
+        capacity = capacity == 0 ? 16 : capacity * 2;
+        pathDirectories = (struct PathDirectory*)realloc(pathDirectories, capacity * sizeof(struct PathDirectory));
+      }
+      struct PathDirectory* directory = &pathDirectories[pathDirectoryCount++];
+      memset(directory, 0, sizeof(struct PathDirectory));
+      directory->path = strndup(searchPath, length);
+      directory->modified = readModificationTime(directory->path);
+      directory->watch = -1;
+    }
+    searchPath += length;
+    if (*searchPath == ':') searchPath++;
+  }
+
+  // Watches go in before anything is read, so a binary added meanwhile is not lost
+  catalogNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  for (int index = 0; index < pathDirectoryCount && catalogNotify >= 0; index++)
+  {
+    pathDirectories[index].watch = inotify_add_watch(catalogNotify, pathDirectories[index].path, CATALOG_WATCH_MASK);
+  }
+
+  // Only directories whose mtime moved since the cache was written are listed again
+  loadCatalogCache();
+  for (int index = 0; index < pathDirectoryCount; index++)
+  {
+    if (pathDirectories[index].loaded) continue;
+    scanPathDirectory(&pathDirectories[index]);
+    catalogChanged = true;
+  }
+  catalogIndexStale = true;
+  if (catalogChanged) saveCatalog();
+}
+
+void loadCatalogCache()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  char path[PATH_MAX];
+  if (!resolveStatePath(path, sizeof(path), "XDG_CACHE_HOME", ".cache", CATALOG_FILE_NAME)) return;
+  int file = open(path, O_RDONLY);
+  if (file < 0) return;
+  struct stat status;
+  if (fstat(file, &status) != 0)
+  {
+    close(file);
+    return;
+  }
+  size_t size = status.st_size;
+  char* data = (char*)malloc(size + 1);
+  size_t loaded = 0;
+  while (loaded < size)
+  {
+    ssize_t result = read(file, data + loaded, size - loaded);
+    if (result <= 0) break;
+    loaded += result;
+  }
+  close(file);
+  if (loaded < sizeof(CATALOG_MAGIC) || memcmp(data, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0)
+  {
+    free(data);
+    return;
+  }
+
+  // A damaged or outdated record is skipped and its directory listed again
+  size_t offset = sizeof(CATALOG_MAGIC);
+  while (offset + sizeof(struct CatalogRecord) <= loaded)
+  {
+    struct CatalogRecord record;
+    memcpy(&record, data + offset, sizeof(record));
+    offset += sizeof(record);
+    if (record.pathLength > loaded - offset || record.namesSize > loaded - offset - record.pathLength) break;
+    const char* recordPath = data + offset;
+    const char* names = recordPath + record.pathLength;
+    offset += record.pathLength + record.namesSize;
+    if (record.namesSize > 0 && names[record.namesSize - 1] != '\0') continue;
+
+    struct PathDirectory* directory = getPathDirectoryByPath(recordPath, record.pathLength);
+    if (directory == NULL || directory->loaded || directory->modified != record.modified) continue;
+    for (const char* name = names; name < names + record.namesSize; name += strlen(name) + 1)
+    {
+      insertCatalogName(directory, directory->count, name);
+    }
+    directory->loaded = true;
+  }
+  free(data);
+}
+
+void saveCatalog()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  char path[PATH_MAX];
+  char temporaryPath[PATH_MAX + 8];
+  if (!resolveStatePath(path, sizeof(path), "XDG_CACHE_HOME", ".cache", CATALOG_FILE_NAME)) return;
+  snprintf(temporaryPath, sizeof(temporaryPath), "%s.new", path);
+
+  FILE* file = fopen(temporaryPath, "w");
+  if (file == NULL)
+  {
+    fprintf(stderr, "Cannot write catalog: %s!\n", temporaryPath);
+    return;
+  }
+
+  // Names are written in sorted order, so loading them back needs no sort
+  fwrite(CATALOG_MAGIC, sizeof(CATALOG_MAGIC), 1, file);
+  for (int index = 0; index < pathDirectoryCount; index++)
+  {
+    struct PathDirectory* directory = &pathDirectories[index];
+    struct CatalogRecord record;
+    record.modified = directory->modified;
+    record.pathLength = strlen(directory->path);
+    record.namesSize = directory->namesLive;
+    fwrite(&record, sizeof(record), 1, file);
+    fwrite(directory->path, 1, record.pathLength, file);
+    for (int position = 0; position < directory->count; position++)
+    {
+      const char* name = directory->names + directory->offsets[position];
+      fwrite(name, 1, strlen(name) + 1, file);
+    }
+  }
+  if (fclose(file) == 0) rename(temporaryPath, path);
+  catalogChanged = false;
+}
+
+void scanPathDirectory(struct PathDirectory* directory)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  directory->modified = readModificationTime(directory->path);
+  directory->namesSize = 0;
+  directory->namesLive = 0;
+  directory->count = 0;
+  directory->loaded = true;
+  DIR* stream = opendir(directory->path);
+  if (stream == NULL) return;
+
+  // Names are appended as found and the offsets sorted once at the end
+  struct dirent* entry;
+  while ((entry = readdir(stream)) != NULL)
+  {
+    if (entry->d_name[0] == '.') continue;
+    if (entry->d_type != DT_REG && entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN) continue;
+    if (!isExecutableAt(dirfd(stream), entry->d_name)) continue;
+    insertCatalogName(directory, directory->count, entry->d_name);
+  }
+  closedir(stream);
+  qsort_r(directory->offsets, directory->count, sizeof(uint32_t), compareCatalogOffsets, directory->names);
+}
+
+bool isExecutableAt(int directoryFd, const char* name)
+{
+  struct stat status;
+  if (fstatat(directoryFd, name, &status, 0) != 0) return false;
+  return S_ISREG(status.st_mode) && (status.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) != 0;
+}
+
+struct PathDirectory* getPathDirectoryByPath(const char* path, size_t length)
+{
+  for (int index = 0; index < pathDirectoryCount; index++)
+  {
+    const char* current = pathDirectories[index].path;
+    if (strncmp(current, path, length) == 0 && current[length] == '\0') return &pathDirectories[index];
+  }
+  return NULL;
+}
+
+struct PathDirectory* getPathDirectoryByWatch(int watch)
+{
+  for (int index = 0; index < pathDirectoryCount; index++)
+  {
+    if (pathDirectories[index].watch == watch) return &pathDirectories[index];
+  }
+  return NULL;
+}
+
+int findCatalogName(struct PathDirectory* directory, const char* name)
+{
+  // Position of the first name that does not sort before the given one
+  int low = 0;
+  int high = directory->count;
+  while (low < high)
+  {
+    int middle = (low + high) / 2;
+    if (strcmp(directory->names + directory->offsets[middle], name) < 0) low = middle + 1;
+    else high = middle;
+  }
+  return low;
+}
+
+void insertCatalogName(struct PathDirectory* directory, int position, const char* name)
+{
+  size_t length = strlen(name) + 1;
+  if (directory->namesSize + length > directory->namesCapacity)
+  {
+    while (directory->namesSize + length > directory->namesCapacity)
+    {
+      directory->namesCapacity = directory->namesCapacity == 0 ? CATALOG_SLACK : directory->namesCapacity * 2;
+    }
+    directory->names = (char*)realloc(directory->names, directory->namesCapacity);
+  }
+  if (directory->count == directory->capacity)
+  {
+    directory->capacity = directory->capacity == 0 ? 64 : directory->capacity * 2;
+    directory->offsets = (uint32_t*)realloc(directory->offsets, directory->capacity * sizeof(uint32_t));
+  }
+  memmove(&directory->offsets[position + 1], &directory->offsets[position], (directory->count - position) * sizeof(uint32_t));
+  directory->offsets[position] = directory->namesSize;
+  memcpy(directory->names + directory->namesSize, name, length);
+  directory->namesSize += length;
+  directory->namesLive += length;
+  directory->count++;
+}
+
+void addCatalogName(struct PathDirectory* directory, const char* name)
+{
+  int position = findCatalogName(directory, name);
+  if (position < directory->count && strcmp(directory->names + directory->offsets[position], name) == 0) return;
+  insertCatalogName(directory, position, name);
+}
+
+void removeCatalogName(struct PathDirectory* directory, const char* name)
+{
+  int position = findCatalogName(directory, name);
+  if (position >= directory->count || strcmp(directory->names + directory->offsets[position], name) != 0) return;
+  directory->namesLive -= strlen(name) + 1;
+  directory->count--;
+  memmove(&directory->offsets[position], &directory->offsets[position + 1], (directory->count - position) * sizeof(uint32_t));
+
+  // Removed names stay in the buffer until they outweigh the live ones
+  if (directory->namesSize - directory->namesLive > directory->namesLive + CATALOG_SLACK) compactCatalogNames(directory);
+}
+
+void compactCatalogNames(struct PathDirectory* directory)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  char* names = (char*)malloc(directory->namesLive + 1);
+  size_t size = 0;
+  for (int position = 0; position < directory->count; position++)
+  {
+    const char* name = directory->names + directory->offsets[position];
+    size_t length = strlen(name) + 1;
+    memcpy(names + size, name, length);
+    directory->offsets[position] = size;
+    size += length;
+  }
+  free(directory->names);
+  directory->names = names;
+  directory->namesSize = size;
+  directory->namesCapacity = directory->namesLive + 1;
+}
+
+int compareCatalogOffsets(const void* first, const void* second, void* names)
+{
+  return strcmp((const char*)names + *(const uint32_t*)first, (const char*)names + *(const uint32_t*)second);
+}
+
+int compareCatalogNames(const void* first, const void* second)
+{
+  return strcmp(*(const char* const*)first, *(const char* const*)second);
+}
+
+void rebuildCatalogIndex()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  int total = 0;
+  for (int index = 0; index < pathDirectoryCount; index++) total += pathDirectories[index].count;
+  catalogIndex = (const char**)realloc(catalogIndex, (total + 1) * sizeof(const char*));
+  catalogIndexCount = 0;
+  for (int index = 0; index < pathDirectoryCount; index++)
+  {
+    struct PathDirectory* directory = &pathDirectories[index];
+    for (int position = 0; position < directory->count; position++)
+    {
+      catalogIndex[catalogIndexCount++] = directory->names + directory->offsets[position];
+    }
+  }
+
+  // A name found in several directories runs the same way from the shell, so it is listed once
+  qsort(catalogIndex, catalogIndexCount, sizeof(const char*), compareCatalogNames);
+  int unique = 0;
+  for (int index = 0; index < catalogIndexCount; index++)
+  {
+    if (unique > 0 && strcmp(catalogIndex[unique - 1], catalogIndex[index]) == 0) continue;
+    catalogIndex[unique++] = catalogIndex[index];
+  }
+  catalogIndexCount = unique;
+  catalogIndexStale = false;
+}
+
+void readCatalogChanges()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  char path[PATH_MAX];
+  bool changed = false;
+  ssize_t length;
+  while ((length = read(catalogNotify, buffer, sizeof(buffer))) > 0)
+  {
+    const struct inotify_event* event;
+    for (char* cursor = buffer; cursor < buffer + length; cursor += sizeof(struct inotify_event) + event->len)
+    {
+      event = (const struct inotify_event*)cursor;
+      changed = true;
+
+      // After an overflow there is no telling what was missed, so everything is listed again
+      if (event->mask & IN_Q_OVERFLOW)
+      {
+        for (int index = 0; index < pathDirectoryCount; index++) scanPathDirectory(&pathDirectories[index]);
+        continue;
+      }
+      struct PathDirectory* directory = getPathDirectoryByWatch(event->wd);
+      if (directory == NULL) continue;
+      directory->modified = readModificationTime(directory->path);
+      if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+      {
+        // The watch follows the old inode, a directory recreated at the path is picked up on the next dialog
+        if (event->mask & IN_MOVE_SELF) inotify_rm_watch(catalogNotify, directory->watch);
+        directory->watch = -1;
+        directory->count = 0;
+        directory->namesLive = 0;
+        continue;
+      }
+      if (event->len == 0 || event->name[0] == '.') continue;
+
+      // Creation, renames and chmod all come down to whether the name is executable now
+      snprintf(path, sizeof(path), "%s/%s", directory->path, event->name);
+      bool gone = (event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0;
+      if (!gone && isExecutableAt(AT_FDCWD, path)) addCatalogName(directory, event->name);
+      else removeCatalogName(directory, event->name);
+    }
+  }
+  if (!changed) return;
+  catalogIndexStale = true;
+  catalogChanged = true;
+
+  // Dialog rows point into the name buffers, which may have moved
+  if (dialogShown)
+  {
+    filterCandidates();
+    renderDialog();
+  }
+}
+
+void rewatchPathDirectories()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  bool changed = false;
+  for (int index = 0; index < pathDirectoryCount && catalogNotify >= 0; index++)
+  {
+    // Directories that were missing or went away are watched again once they exist, then listed
+    struct PathDirectory* directory = &pathDirectories[index];
+    if (directory->watch >= 0) continue;
+    directory->watch = inotify_add_watch(catalogNotify, directory->path, CATALOG_WATCH_MASK);
+    if (directory->watch < 0) continue;
+    scanPathDirectory(directory);
+    changed = true;
+  }
+  if (!changed) return;
+  catalogIndexStale = true;
+  catalogChanged = true;
+}
+
+void matchCatalog(int64_t now)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  // There are far too many executables to list before anything is typed
+  if (dialogQueryLength == 0 || pathDirectoryCount == 0) return;
+  if (catalogIndexStale) rebuildCatalogIndex();
+
+  // Names starting with the query are one range of the sorted index
+  int low = 0;
+  int high = catalogIndexCount;
+  while (low < high)
+  {
+    int middle = (low + high) / 2;
+    if (strcmp(catalogIndex[middle], dialogQuery) < 0) low = middle + 1;
+    else high = middle;
+  }
+  int first = low;
+  int end = first;
+  while (end < catalogIndexCount && strncmp(catalogIndex[end], dialogQuery, dialogQueryLength) == 0)
+  {
+    insertCandidate(catalogIndex[end], catalogIndex[end], false, 0, now);
+    end++;
+  }
+
+  // The fuzzy pass over the rest only runs while it can still reach the list
+  if (dialogMatchCount == DIALOG_ROW_LIMIT && dialogMatches[DIALOG_ROW_LIMIT - 1].score == 0) return;
+  for (int index = 0; index < catalogIndexCount; index++)
+  {
+    if (index >= first && index < end) continue;
+    int score = calculateCatalogScore(catalogIndex[index]);
+    if (score >= 0) insertCandidate(catalogIndex[index], catalogIndex[index], false, score, now);
+  }
+}
+
+int calculateCatalogScore(const char* name)
+{
+  // Prefix and substring rank like any other name, then the query letters in order
+  if (strncasecmp(name, dialogQuery, dialogQueryLength) == 0) return 0;
+  if (strcasestr(name, dialogQuery) != NULL) return 1;
+  const char* query = dialogQuery;
+  for (const char* cursor = name; *cursor != '\0' && *query != '\0'; cursor++)
+  {
+    if (tolower((unsigned char)*cursor) == tolower((unsigned char)*query)) query++;
+  }
+  return *query == '\0' ? CATALOG_FUZZY_SCORE : -1;
+}
+
+void loadApplets()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  char path[PATH_MAX];
+  const char* directory = getenv(APPLET_DIR_ENV_NAME);
+  if (directory != NULL && directory[0] == '/') snprintf(path, sizeof(path), "%s", directory);
+  else if (!resolveStatePath(path, sizeof(path), "XDG_CONFIG_HOME", ".config", APPLET_DIR_NAME)) return;
+
+  // Cells follow the file names, so a numeric prefix orders them
+  struct dirent** entries = NULL;
+  int entryCount = scandir(path, &entries, NULL, alphasort);
+  for (int index = 0; index < entryCount; index++)
+  {
+    size_t length = strlen(entries[index]->d_name);
+    if (appletCount < APPLET_LIMIT && length > 3 && strcmp(entries[index]->d_name + length - 3, ".so") == 0)
+    {
+      char filePath[PATH_MAX + 256];
+      snprintf(filePath, sizeof(filePath), "%s/%s", path, entries[index]->d_name);
+      loadApplet(filePath);
+    }
+    free(entries[index]);
+  }
+  free(entries);
+}
+
+void loadApplet(const char* path)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  void* library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (library == NULL)
+  {
+    fprintf(stderr, "Cannot load applet: %s!\n", dlerror());
+    return;
+  }
+  AppletEntry entry = (AppletEntry)dlsym(library, APPLET_ENTRY_NAME);
+  const struct AppletDescriptor* descriptor = entry != NULL ? entry() : NULL;
+  if (descriptor == NULL || descriptor->apiVersion != APPLET_API_VERSION || descriptor->intervalMs <= 0)
+  {
+    fprintf(stderr, "Not a compatible applet: %s!\n", path);
+    dlclose(library);
+    return;
+  }
+
+  // Applets without their data source, such as a battery on a desktop, opt out here
+  void* state = descriptor->create();
+  if (state == NULL)
+  {
+    dlclose(library);
+    return;
+  }
+
+  struct AppletInstance* applet = &applets[appletCount++];
+  applet->descriptor = descriptor;
+  applet->library = library;
+  applet->state = state;
+  applet->interval = (uint64_t)descriptor->intervalMs * 1000;
+  applet->nextTick = (currentTime() / applet->interval + 1) * applet->interval;
+  applet->x = 0;
+  applet->canvas.width = 0;
+  applet->canvas.height = 0;
+  applet->canvas.host = applet;
+  applet->canvas.drawText = drawAppletText;
+  applet->canvas.drawBar = drawAppletBar;
+  descriptor->update(state);
+}
+
+int layoutApplets(int x)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // Cells sit after the icons, separated by the usual gap
+  for (int index = 0; index < appletCount; index++)
+  {
+    struct AppletInstance* applet = &applets[index];
+    applet->x = x;
+    applet->canvas.width = scaleDimension(applet->descriptor->cellWidth, layout.scale);
+    applet->canvas.height = layout.iconBoxSize;
+    x += applet->canvas.width + layout.gapSize;
+  }
+  return x;
+}
+
+void tickApplets()
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  // Everything due within the slack shares this wakeup, next ticks land on a common grid
+  uint64_t now = currentTime();
+  for (int index = 0; index < appletCount; index++)
+  {
+    struct AppletInstance* applet = &applets[index];
+    if (applet->nextTick > now + APPLET_COALESCE_MS * 1000) continue;
+
+    // An applet pulled in early counts as having ticked at its grid point, not before it
+    uint64_t tickTime = applet->nextTick > now ? applet->nextTick : now;
+    applet->nextTick = (tickTime / applet->interval + 1) * applet->interval;
+    if (applet->descriptor->update(applet->state) && panelBuffer != None)
+    {
+      renderAppletCell(applet);
+      presentPanelArea(applet->x, layout.gapSize, applet->canvas.width, applet->canvas.height);
+    }
+  }
+  scheduleApplets();
+}
+
+void scheduleApplets()
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  uint64_t nextTick = 0;
+  for (int index = 0; index < appletCount; index++)
+  {
+    if (nextTick == 0 || applets[index].nextTick < nextTick) nextTick = applets[index].nextTick;
+  }
+  if (nextTick == 0) disarmTimer(TIMER_APPLET);
+  else armTimerAt(TIMER_APPLET, nextTick);
+}
+
+void renderApplets()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  for (int index = 0; index < appletCount; index++)
+  {
+    renderAppletCell(&applets[index]);
+  }
+}
+
+void renderAppletCell(struct AppletInstance* applet)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  XSetForeground(display, panelGC, cIconBackground);
+  XFillRectangle(display, panelBuffer, panelGC, applet->x, layout.gapSize, applet->canvas.width, applet->canvas.height);
+  applet->descriptor->draw(applet->state, &applet->canvas);
+}
+
+void drawAppletText(struct AppletCanvas* canvas, const char* text)
+{
+  struct AppletInstance* applet = (struct AppletInstance*)canvas->host;
+  struct TextLabel* label = getTextLabel(text, cMenuForeground, cIconBackground, canvas->width, canvas->height);
+  XCopyArea(display, label->pixelMap, panelBuffer, panelGC, 0, 0, label->width, label->height, applet->x, layout.gapSize);
+}
+
+void drawAppletBar(struct AppletCanvas* canvas, float fraction)
+{
+  struct AppletInstance* applet = (struct AppletInstance*)canvas->host;
+  if (fraction < 0.0f) fraction = 0.0f;
+  if (fraction > 1.0f) fraction = 1.0f;
+  int barHeight = scaleDimension(APPLET_BAR_HEIGHT, layout.scale);
+  XSetForeground(display, panelGC, cPanelBorder);
+  XFillRectangle(
+    display,
+    panelBuffer,
+    panelGC,
+    applet->x,
+    layout.gapSize + canvas->height - barHeight,
+    (unsigned int)(canvas->width * fraction + 0.5f),
+    barHeight
+  );
+}
+
+void startPanelSlide(bool hide)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (hide == panelHidden) return;
+  panelHidden = hide;
+  if (hide) hideTooltip();
+  else XUnmapWindow(display, triggerWindow);
+
+  // A slide reversed halfway starts from wherever the panel is right now
+  slideFromY = panelCurrentY;
+  slideToY = hide ? calculateHiddenPanelY() : panelY;
+  slideStartTime = currentTime();
+  slideCpuStartTime = currentCpuTime();
+  slideFrame = 0;
+  slideDroppedFrames = 0;
+  panelSliding = true;
+  if (slideDuration == 0) advancePanelSlide();
+  else armTimerAt(TIMER_FRAME, slideStartTime + frameInterval);
+}
+
+void advancePanelSlide()
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  // Frames sit on a fixed grid from the start, so a late wakeup never shifts the next one
+  uint64_t now = currentTime();
+  int frame = (int)((now - slideStartTime) / frameInterval);
+  if (frame > slideFrame + 1) slideDroppedFrames += frame - slideFrame - 1;
+  slideFrame = frame;
+
+  uint64_t elapsed = (uint64_t)frame * frameInterval;
+  float progress = elapsed >= slideDuration ? 1.0f : (float)elapsed / slideDuration;
+  float eased = 1.0f - (1.0f - progress) * (1.0f - progress);
+
+  // Only the window moves, the server copies the pixels it already has
+  panelCurrentY = slideFromY + (int)lroundf((slideToY - slideFromY) * eased);
+  XMoveWindow(display, panelWindow, panelX, panelCurrentY);
+
+  if (progress < 1.0f)
+  {
+    armTimerAt(TIMER_FRAME, slideStartTime + (uint64_t)(frame + 1) * frameInterval);
+    return;
+  }
+
+  // The panel slides in under the pointer, whose EnterNotify has already disarmed the timer
+  panelSliding = false;
+  if (panelHidden) XMapRaised(display, triggerWindow);
+  else if (!pointerInsidePanel) armTimer(TIMER_AUTO_HIDE, AUTO_HIDE_DELAY_MS * 1000);
+  if (DEBUG_ANIMATION_STATS)
+  {
+    printf(
+      "slide %s: %d frames, %d dropped, %.2f ms CPU\n",
+      panelHidden ? "out" : "in",
+      slideFrame,
+      slideDroppedFrames,
+      (currentCpuTime() - slideCpuStartTime) / 1000.0
+    );
+  }
+}
+
+int calculateHiddenPanelY()
+{
+  // Entirely below the screen, the trigger strip brings it back
+  return DisplayHeight(display, DefaultScreen(display));
+}
+
+void beginIconDrag(int index, int pointerX)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  iconDragging = true;
+  dragIndex = index;
+  dragTargetIndex = index;
+  dragDrawnX = calculateIconX(index);
+  dragGrabOffset = pointerX - dragDrawnX;
+  dragPointerX = pointerX;
+  lastDragFrameTime = currentTime();
+  renderDragArea(dragDrawnX, layout.iconBoxSize);
+}
+
+void updateIconDrag(int pointerX)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  dragPointerX = pointerX;
+  if (timerDeadlines[TIMER_DRAG_FRAME] != 0) return;
+
+  // Motion is coalesced into at most one frame per refresh interval
+  uint64_t now = currentTime();
+  uint64_t nextFrameTime = lastDragFrameTime + frameInterval;
+  armTimerAt(TIMER_DRAG_FRAME, nextFrameTime > now ? nextFrameTime : now);
+}
+
+void advanceIconDrag()
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  lastDragFrameTime = currentTime();
+  int slotSize = layout.iconBoxSize + layout.gapSize;
+
+  // Holding the icon near either end scrolls the panel under it
+  int scrollDelta = 0;
+  if (dragPointerX < slotSize / 2) scrollDelta = -slotSize / 4;
+  else if (dragPointerX > panelIconAreaWidth - slotSize / 2) scrollDelta = slotSize / 4;
+  bool scrolled = scrollDelta != 0 && scrollPanel(scrollDelta);
+
+  int previousX = dragDrawnX;
+  int previousTargetIndex = dragTargetIndex;
+  int minX = layout.gapSize;
+  int maxX = panelIconAreaWidth - layout.gapSize - layout.iconBoxSize;
+  dragDrawnX = dragPointerX - dragGrabOffset;
+  if (dragDrawnX > maxX) dragDrawnX = maxX;
+  if (dragDrawnX < minX) dragDrawnX = minX;
+
+  dragTargetIndex = (dragDrawnX + layout.iconBoxSize / 2 + panelScrollOffset - layout.gapSize / 2) / slotSize;
+  if (dragTargetIndex >= (int)iconTableCount) dragTargetIndex = (int)iconTableCount - 1;
+  if (dragTargetIndex < 0) dragTargetIndex = 0;
+
+  if (scrolled)
+  {
+    renderDragArea(0, panelIconAreaWidth);
+    armTimerAt(TIMER_DRAG_FRAME, lastDragFrameTime + frameInterval);
+    return;
+  }
+
+  // Only the old and new icon positions and the slots whose icons shifted change
+  int left = previousX < dragDrawnX ? previousX : dragDrawnX;
+  int right = (previousX > dragDrawnX ? previousX : dragDrawnX) + layout.iconBoxSize;
+  if (dragTargetIndex != previousTargetIndex)
+  {
+    int firstShifted = previousTargetIndex < dragTargetIndex ? previousTargetIndex : dragTargetIndex;
+    int lastShifted = previousTargetIndex > dragTargetIndex ? previousTargetIndex : dragTargetIndex;
+    if (calculateIconX(firstShifted) < left) left = calculateIconX(firstShifted);
+    if (calculateIconX(lastShifted) + layout.iconBoxSize > right) right = calculateIconX(lastShifted) + layout.iconBoxSize;
+  }
+  renderDragArea(left, right - left);
+}
+
+bool finishIconDrag()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  disarmTimer(TIMER_DRAG_FRAME);
+  iconDragging = false;
+  if (dragTargetIndex == dragIndex) return false;
+  moveIconToIndex(dragIndex, dragTargetIndex);
+  return true;
+}
+
+void cancelIconDrag()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  disarmTimer(TIMER_DRAG_FRAME);
+  iconDragging = false;
+}
+
+void renderDragArea(int x, int width)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  int slotSize = layout.iconBoxSize + layout.gapSize;
+  int firstSlot = (x + panelScrollOffset - layout.gapSize) / slotSize;
+  int lastSlot = (x + width - 1 + panelScrollOffset - layout.gapSize) / slotSize;
+  if (firstSlot < 0) firstSlot = 0;
+  if (lastSlot >= (int)iconTableCount) lastSlot = (int)iconTableCount - 1;
+
+  // Whole slots including their trailing gap are redrawn, clamped to the buffer
+  int areaLeft = calculateIconX(firstSlot);
+  int areaRight = calculateIconX(lastSlot) + slotSize;
+  if (areaLeft < 0) areaLeft = 0;
+  if (areaRight > panelIconAreaWidth) areaRight = panelIconAreaWidth;
+  if (areaRight <= areaLeft) return;
+  XSetForeground(display, panelGC, cPanelBackground);
+  XFillRectangle(display, panelBuffer, panelGC, areaLeft, 0, areaRight - areaLeft, layout.panelHeight);
+
+  for (int slot = firstSlot; slot <= lastSlot; slot++)
+  {
+    renderIconAtIndex(slot);
+    int index = calculateDragIconAtSlot(slot);
+    if (index >= 0) renderIconPixelMapAtX(index, calculateIconX(slot));
+  }
+
+  // The dragged icon floats above its neighbours
+  XSetForeground(display, panelGC, cIconHover);
+  XFillRectangle(display, panelBuffer, panelGC, dragDrawnX, layout.gapSize, clipToIconArea(dragDrawnX, layout.iconBoxSize), layout.iconBoxSize);
+  renderIconPixelMapAtX(dragIndex, dragDrawnX);
+  presentPanelArea(areaLeft, 0, areaRight - areaLeft, layout.panelHeight);
+}
+
+int calculateDragIconAtSlot(int slot)
+{
+  // The target slot stays empty and the icons between it and the origin shift by one
+  if (slot == dragTargetIndex) return -1;
+  if (dragIndex < dragTargetIndex && slot >= dragIndex && slot < dragTargetIndex) return slot + 1;
+  if (dragTargetIndex < dragIndex && slot > dragTargetIndex && slot <= dragIndex) return slot - 1;
+  return slot;
+}
+
+void grabPointer()
+{
+  XGrabPointer(
+    display,
+    menuWindow,
+    false,
+    ButtonPressMask | ButtonReleaseMask | PointerMotionMask | EnterWindowMask | LeaveWindowMask,
+    GrabModeAsync,
+    GrabModeAsync,
+    None,
+    None,
+    CurrentTime
+  );
+  noteRoundTrips(1);
+}
+
+void releasePointer()
+{
+  XUngrabPointer(display, CurrentTime);
+}
+
+void renderPanel(int hoveredIndex)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (panelBuffer == None) return;
+  renderIcons(hoveredIndex);
+  renderIconPixelMaps();
+  renderIconIds();
+  renderApplets();
+  presentPanelArea(0, 0, panelBufferWidth, layout.panelHeight);
+}
+
+void presentPanelArea(int x, int y, int width, int height)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  if (panelBuffer == None) return;
+  XCopyArea(display, panelBuffer, panelWindow, panelGC, x, y, width, height, x, y);
+}
+
+void presentIconAtIndex(int index)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  if (index < 0) return;
+  int iconX = calculateIconX(index);
+  int width = clipToIconArea(iconX, layout.iconBoxSize);
+  if (width > 0) presentPanelArea(iconX, layout.gapSize, width, layout.iconBoxSize);
+}
+
+void presentIconSpan(int firstIndex, int secondIndex)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  if (firstIndex < 0 || secondIndex < 0)
+  {
+    presentIconAtIndex(firstIndex);
+    presentIconAtIndex(secondIndex);
+    return;
+  }
+  int left = calculateIconX(firstIndex < secondIndex ? firstIndex : secondIndex);
+  int right = calculateIconX(firstIndex < secondIndex ? secondIndex : firstIndex) + layout.iconBoxSize;
+  int width = clipToIconArea(left, right - left);
+  if (width > 0) presentPanelArea(left, layout.gapSize, width, layout.iconBoxSize);
+}
+
+void renderIconAtIndex(int index)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  int iconX = calculateIconX(index);
+  int iconY = layout.gapSize;
+  int width = clipToIconArea(iconX, layout.iconBoxSize);
+  if (width == 0) return;
+  XSetForeground(display, panelGC, cIconBackground);
+  XFillRectangle(
+    display,
+    panelBuffer,
+    panelGC,
+    iconX,
+    iconY,
+    width,
+    layout.iconBoxSize
+  );
+}
+
+void renderIconHoverAtIndex(int index)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  int hoverX = calculateIconX(index);
+  int hoverY = layout.gapSize;
+  int width = clipToIconArea(hoverX, layout.iconBoxSize);
+  if (width == 0) return;
+  XSetForeground(display, panelGC, cIconHover);
+  XFillRectangle(
+    display,
+    panelBuffer,
+    panelGC,
+    hoverX,
+    hoverY,
+    width,
+    layout.iconBoxSize
+  );
+  XSetForeground(display, panelGC, cIconBackground);
+}
+
+void renderIcons(int hoveredIndex)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  panelFrame++;
+  XSetForeground(display, panelGC, cPanelBackground);
+  XFillRectangle(display, panelBuffer, panelGC, 0, 0, panelBufferWidth, layout.panelHeight);
+
+  int first = 0;
+  int last = -1;
+  calculateVisibleIconRange(&first, &last);
+  for (int index = first; index <= last; index++)
+  {
+    if (index == hoveredIndex) renderIconHoverAtIndex(index);
+    else renderIconAtIndex(index);
+  }
+}
+
+void renderIconPixelMapAtIndex(int index)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  renderIconPixelMapAtX(index, calculateIconX(index));
+}
+
+void renderIconPixelMapAtX(int index, int iconX)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  struct IconNode* icon = getIconByIndex(index);
+  if (icon == NULL || icon->image == NULL) return;
+  icon->image->lastUsedFrame = panelFrame;
+  if (!icon->image->resident) return;
+  iconX += layout.iconInset;
+  int iconY = layout.gapSize + layout.iconInset;
+  int width = clipToIconArea(iconX, layout.iconSize);
+  if (width == 0) return;
+  XSetClipMask(display, panelGC, icon->image->mask);
+  XSetClipOrigin(display, panelGC, iconX, iconY);
+  XCopyArea(display, icon->image->pixelMap, panelBuffer, panelGC, 0, 0, width, layout.iconSize, iconX, iconY);
+  XSetClipMask(display, panelGC, None);
+}
+
+void renderIconPixelMaps()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  int first = 0;
+  int last = -1;
+  calculateVisibleIconRange(&first, &last);
+  for (int index = first; index <= last; index++)
+  {
+    renderIconPixelMapAtIndex(index);
+  }
+}
+
+void renderIconIdAtIndex(int index)
+{
+  if (!DEBUG_RENDER_ICON_IDS) return;
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  struct IconNode* icon = getIconByIndex(index);
+  if (icon == NULL) return;
+  XSetForeground(display, panelGC, cMenuForeground);
+  int iconX = calculateIconX(index);
+  char* idBuffer = (char*)malloc(sizeof(4));
+  snprintf(idBuffer, 4, "%d", icon->id);
+  XDrawString(display, panelBuffer, panelGC, iconX + 2, layout.gapSize + 10 + 2, idBuffer, strlen(idBuffer));
+  free(idBuffer);
+}
+
+void renderIconIds()
+{
+  if (!DEBUG_RENDER_ICON_IDS) return;
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  int first = 0;
+  int last = -1;
+  calculateVisibleIconRange(&first, &last);
+  for (int index = first; index <= last; index++)
+  {
+    renderIconIdAtIndex(index);
+  }
+}
+
+void renderMenuItemAtIndex(const char** menuItems, int index, bool hovered)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (index < 0 || index >= menuBufferItemCount) return;
+  if (!hovered)
+  {
+    renderMenuArea(0, index * layout.itemHeight, layout.itemWidth, layout.itemHeight);
+    return;
+  }
+  Pixmap label = getTextLabel(menuItems[index], cMenuForeground, cMenuHover, layout.itemWidth, layout.itemHeight)->pixelMap;
+  XCopyArea(display, label, menuWindow, menuGC, 0, 0, layout.itemWidth, layout.itemHeight, 0, index * layout.itemHeight);
+}
+
+void renderMenuArea(int x, int y, int width, int height)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (menuBuffer == None) return;
+  XCopyArea(display, menuBuffer, menuWindow, menuGC, x, y, width, height, x, y);
+}
+
+void composeMenuBuffer(const char** menuItems, int itemCount)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // The buffer only grows, so switching between menus of different lengths
+  // reuses the same pixmap instead of allocating one per menu
+  if (menuBuffer != None && (menuBufferRows < itemCount || menuBufferWidth != layout.itemWidth))
+  {
+    freeMenuBuffer();
+  }
+  if (menuBuffer == None)
+  {
+    int rows = menuBufferRows;
+    if (rows < itemCount) rows = rows * 2 > itemCount ? rows * 2 : itemCount;
+    menuBuffer = XCreatePixmap(
+      display,
+      menuWindow,
+      layout.itemWidth,
+      rows * layout.itemHeight,
+      DefaultDepth(display, DefaultScreen(display))
+    );
+    menuBufferRows = rows;
+    menuBufferWidth = layout.itemWidth;
+  }
+  menuBufferItemCount = itemCount;
+  for (int i = 0; i < itemCount; i++)
+  {
+    Pixmap label = getTextLabel(menuItems[i], cMenuForeground, cMenuBackground, layout.itemWidth, layout.itemHeight)->pixelMap;
+    XCopyArea(display, label, menuBuffer, menuGC, 0, 0, layout.itemWidth, layout.itemHeight, 0, i * layout.itemHeight);
+  }
+}
+
+void freeMenuBuffer()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (menuBuffer != None) XFreePixmap(display, menuBuffer);
+  menuBuffer = None;
+}
+
+void loadFont(float scale)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // Xft keeps the glyphs of the new size server-side, existing labels are stale
+  flushTextLabels();
+  if (font != NULL) XftFontClose(display, font);
+  font = XftFontOpen(
+    display,
+    DefaultScreen(display),
+    XFT_FAMILY, XftTypeString, FONT_FAMILY,
+    XFT_PIXEL_SIZE, XftTypeDouble, (double)scaleDimension(FONT_PIXEL_SIZE, scale),
+    XFT_MAX_GLYPH_MEMORY, XftTypeInteger, FONT_GLYPH_MEMORY_LIMIT,
+    NULL
+  );
+  if (font == NULL)
+  {
+    fprintf(stderr, "Cannot open font: %s!\n", FONT_FAMILY);
+    exit(EXIT_FAILURE);
+  }
+}
+
+struct TextLabel* getTextLabel(const char* text, unsigned long foreground, unsigned long background, int width, int height)
+{
+  // A zero width or height sizes the label to fit its text
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  struct TextLabel* previous = NULL;
+  struct TextLabel* current = textLabelList;
+  while (current != NULL)
+  {
+    if (
+      current->foreground == foreground && current->background == background &&
+      current->requestedWidth == width && current->requestedHeight == height &&
+      strcmp(current->text, text) == 0
+    )
+    {
+      if (previous != NULL)
+      {
+        previous->next = current->next;
+        current->next = textLabelList;
+        textLabelList = current;
+      }
+      textLabelStats.hits++;
+      return current;
+    }
+    previous = current;
+    current = current->next;
+  }
+
+  textLabelStats.misses++;
+  if (textLabelCount >= LABEL_CACHE_LIMIT)
+  {
+    // Evict the least recently used label at the tail
+    struct TextLabel** tail = &textLabelList;
+    while ((*tail)->next != NULL) tail = &(*tail)->next;
+    freeTextLabel(*tail);
+    *tail = NULL;
+    textLabelCount--;
+    textLabelStats.evictions++;
+  }
+
+  struct TextLabel* label = createTextLabel(text, foreground, background, width, height);
+  label->next = textLabelList;
+  textLabelList = label;
+  textLabelCount++;
+  return label;
+}
+
+struct TextLabel* createTextLabel(const char* text, unsigned long foreground, unsigned long background, int width, int height)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // Labels made here outside the cache belong to the caller
+  struct TextLabel* label = (struct TextLabel*)malloc(sizeof(struct TextLabel));
+  label->text = strdup(text);
+  label->foreground = foreground;
+  label->background = background;
+  label->requestedWidth = width;
+  label->requestedHeight = height;
+  label->width = width;
+  label->height = height;
+  label->next = NULL;
+  renderTextLabel(label);
+  return label;
+}
+
+void renderTextLabel(struct TextLabel* label)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  int lineHeight = font->ascent + font->descent;
+  int lineCount = 1;
+  int textWidth = 0;
+  const char* line = label->text;
+  while (line != NULL)
+  {
+    const char* lineEnd = strchr(line, '\n');
+    int lineLength = lineEnd != NULL ? lineEnd - line : (int)strlen(line);
+    XGlyphInfo extents;
+    XftTextExtentsUtf8(display, font, (const FcChar8*)line, lineLength, &extents);
+    if (extents.xOff > textWidth) textWidth = extents.xOff;
+    if (lineEnd != NULL) lineCount++;
+    line = lineEnd != NULL ? lineEnd + 1 : NULL;
+  }
+  if (label->width == 0) label->width = textWidth + 2 * layout.itemTextX;
+  if (label->height == 0) label->height = lineCount * lineHeight + 2 * layout.gapSize;
+
+  int screenNum = DefaultScreen(display);
+  label->pixelMap = XCreatePixmap(display, panelWindow, label->width, label->height, DefaultDepth(display, screenNum));
+
+  XftColor backgroundColor;
+  XftColor foregroundColor;
+  toXftColor(label->background, &backgroundColor);
+  toXftColor(label->foreground, &foregroundColor);
+
+  XftDraw* draw = XftDrawCreate(display, label->pixelMap, DefaultVisual(display, screenNum), DefaultColormap(display, screenNum));
+  XftDrawRect(draw, &backgroundColor, 0, 0, label->width, label->height);
+  int baseline = (label->height - lineCount * lineHeight) / 2 + font->ascent;
+  line = label->text;
+  while (line != NULL)
+  {
+    const char* lineEnd = strchr(line, '\n');
+    int lineLength = lineEnd != NULL ? lineEnd - line : (int)strlen(line);
+    XftDrawStringUtf8(draw, &foregroundColor, font, layout.itemTextX, baseline, (const FcChar8*)line, lineLength);
+    baseline += lineHeight;
+    line = lineEnd != NULL ? lineEnd + 1 : NULL;
+  }
+  XftDrawDestroy(draw);
+}
+
+void freeTextLabel(struct TextLabel* label)
+{
+  XFreePixmap(display, label->pixelMap);
+  free(label->text);
+  free(label);
+}
+
+void flushTextLabels()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  struct TextLabel* current = textLabelList;
+  while (current != NULL)
+  {
+    struct TextLabel* next = current->next;
+    freeTextLabel(current);
+    current = next;
+  }
+  textLabelList = NULL;
+  textLabelCount = 0;
+
+  // Tooltips are owned by their icons but share the font
+  for (unsigned int index = 0; index < iconTableCount; index++) freeIconTooltip(iconTable[index]);
+}
+
+void toXftColor(unsigned long pixel, XftColor* color)
+{
+  // Colors come from calculateRGB, so the pixel value is plain 0xRRGGBB
+  color->pixel = pixel;
+  color->color.red = ((pixel >> 16) & 0xff) * 0x101;
+  color->color.green = ((pixel >> 8) & 0xff) * 0x101;
+  color->color.blue = (pixel & 0xff) * 0x101;
+  color->color.alpha = 0xffff;
+}
+
+int calculatePanelWidth(int iconCount)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  return layout.gapSize * 2 + (iconCount - 1) * layout.gapSize + iconCount * layout.iconBoxSize;
+}
+
+int calculateVisibleIconCount(int iconCount, int screenWidth)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  int fittingCount = (screenWidth - layout.gapSize) / (layout.iconBoxSize + layout.gapSize);
+  int visibleCount = iconCount;
+  if (visibleCount > VISIBLE_ICON_LIMIT) visibleCount = VISIBLE_ICON_LIMIT;
+  if (visibleCount > fittingCount) visibleCount = fittingCount;
+  return visibleCount;
+}
+
+void calculateVisibleIconRange(int* first, int* last)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  int slotSize = layout.iconBoxSize + layout.gapSize;
+  *first = panelScrollOffset / slotSize;
+  *last = (panelScrollOffset + panelIconAreaWidth) / slotSize;
+  if (*last >= (int)iconTableCount) *last = (int)iconTableCount - 1;
+}
+
+int calculateIconX(int index)
+{
+  return index * (layout.iconBoxSize + layout.gapSize) + layout.gapSize - panelScrollOffset;
+}
+
+int clipToIconArea(int x, int width)
+{
+  // Applet cells start where the icon area ends, a partly scrolled in icon stops there
+  if (x + width > panelIconAreaWidth) width = panelIconAreaWidth - x;
+  return width > 0 ? width : 0;
+}
+
+bool scrollPanel(int delta)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  int scrollOffset = panelScrollOffset + delta;
+  int maxScrollOffset = panelContentWidth - panelIconAreaWidth;
+  if (scrollOffset > maxScrollOffset) scrollOffset = maxScrollOffset;
+  if (scrollOffset < 0) scrollOffset = 0;
+  if (scrollOffset == panelScrollOffset) return false;
+  panelScrollOffset = scrollOffset;
+  return true;
+}
+
+int calculateIconIndexFromMouseX(int relMouseX, int iconCount)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  int iconIndex = 0;
+  if (relMouseX < 0 || relMouseX >= panelIconAreaWidth) { return -1; }
+  relMouseX += panelScrollOffset;
+  if (
+    relMouseX > layout.gapSize + layout.gapSize / 2 + layout.iconBoxSize
+  )
+  { iconIndex = (relMouseX - layout.gapSize / 2) / (layout.iconBoxSize + layout.gapSize); }
+  if (iconIndex == iconCount) iconIndex--;
+  return iconIndex;
+}
+
+int calculateItemIndexFromMouseY(int relMouseY, int itemCount)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  // The bottom border still counts as inside the grabbed menu, but it is no item
+  if (relMouseY < 0 || relMouseY >= layout.itemHeight * itemCount) return -1;
+  return relMouseY / layout.itemHeight;
+}
+
+float readScale(const char* resourceString)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  float scale = MIN_SCALE;
+  const char* setting = getenv(SCALE_ENV_NAME);
+  if (setting != NULL)
+  {
+    scale = strtof(setting, NULL);
+  }
+  else if (resourceString != NULL)
+  {
+    XrmDatabase database = XrmGetStringDatabase(resourceString);
+    char* type = NULL;
+    XrmValue value;
+    if (database != NULL && XrmGetResource(database, "Xft.dpi", "Xft.Dpi", &type, &value) && value.addr != NULL)
+    {
+      scale = strtof(value.addr, NULL) / DEFAULT_DPI;
+    }
+    if (database != NULL) XrmDestroyDatabase(database);
+  }
+  if (!(scale >= MIN_SCALE)) scale = MIN_SCALE;
+  if (scale > MAX_SCALE) scale = MAX_SCALE;
+  return scale;
+}
+
+char* readResourceManagerProperty()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  Atom actualType;
+  int actualFormat;
+  unsigned long itemCount;
+  unsigned long bytesAfter;
+  unsigned char* data = NULL;
+  int result = XGetWindowProperty(
+    display,
+    DefaultRootWindow(display),
+    XA_RESOURCE_MANAGER,
+    0,
+    LONG_MAX,
+    false,
+    XA_STRING,
+    &actualType,
+    &actualFormat,
+    &itemCount,
+    &bytesAfter,
+    &data
+  );
+  noteRoundTrips(1);
+  if (result != Success || actualType != XA_STRING)
+  {
+    if (data != NULL) XFree(data);
+    return NULL;
+  }
+  return (char*)data;
+}
+
+void calculateLayout(float scale)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  layout.scale = scale;
+  layout.borderWidth = scaleDimension(WINDOW_BORDER_WIDTH, scale);
+  layout.gapSize = scaleDimension(GAP_SIZE, scale);
+  layout.iconBoxSize = scaleDimension(ICON_BOX_SIZE, scale);
+  layout.iconMipLevel = selectIconMipLevel(scale);
+  layout.iconSize = calculateIconMipSize(layout.iconMipLevel);
+  layout.iconInset = (layout.iconBoxSize - layout.iconSize) / 2;
+  layout.panelHeight = layout.iconBoxSize + 2 * layout.gapSize;
+  layout.panelBottomOffset = scaleDimension(PANEL_BOTTOM_OFFSET, scale);
+  layout.triggerHeight = scaleDimension(TRIGGER_HEIGHT, scale);
+  layout.itemWidth = scaleDimension(ITEM_WIDTH, scale);
+  layout.itemHeight = scaleDimension(ITEM_HEIGHT, scale);
+  layout.itemTextX = scaleDimension(ITEM_TEXT_X, scale);
+}
+
+void applyScale(float scale)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // Pixmaps of the old mip level are dropped, the lazy loader uploads the new
+  // one from the packed pixels an icon per idle pass instead of all at once
+  int previousLevel = layout.iconMipLevel;
+  calculateLayout(scale);
+  if (layout.iconMipLevel != previousLevel)
+  {
+    for (struct IconImage* image = iconImageList; image != NULL; image = image->next) unloadIconImage(image);
+  }
+  XSetWindowBorderWidth(display, panelWindow, layout.borderWidth);
+  if (menuWindow != None) XSetWindowBorderWidth(display, menuWindow, layout.borderWidth);
+  if (dialogWindow != None) XSetWindowBorderWidth(display, dialogWindow, layout.borderWidth);
+  if (triggerWindow != None)
+  {
+    int screenNum = DefaultScreen(display);
+    int screenHeight = DisplayHeight(display, screenNum);
+    XMoveResizeWindow(display, triggerWindow, 0, screenHeight - layout.triggerHeight, DisplayWidth(display, screenNum), layout.triggerHeight);
+  }
+  freeMenuBuffer();
+  loadFont(scale);
+  if (dialogWindow != None) resizeDialog();
+  if (dialogShown) renderDialog();
+}
+
+int scaleDimension(int size, float scale)
+{
+  return (int)(size * scale + 0.5f);
+}
+
+int selectIconMipLevel(float scale)
+{
+  int nearestLevel = 0;
+  for (int level = 1; level < ICON_MIP_LEVEL_COUNT; level++)
+  {
+    if (fabsf(ICON_MIP_SCALES[level] - scale) < fabsf(ICON_MIP_SCALES[nearestLevel] - scale))
+    {
+      nearestLevel = level;
+    }
+  }
+  return nearestLevel;
+}
+
+int calculateIconMipSize(int level)
+{
+  return scaleDimension(ICON_SIZE, ICON_MIP_SCALES[level]);
+}
+
+struct IconImage* loadIconImage(const char* filePath)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  struct IconImage* current = iconImageList;
+  while (current != NULL)
+  {
+    if (strcmp(current->path, filePath) == 0)
+    {
+      current->refCount++;
+      return current;
+    }
+    current = current->next;
+  }
+
+  // Pixels are decoded later, once the icon scrolls into view
+  struct IconImage* image = (struct IconImage*)malloc(sizeof(struct IconImage));
+  image->path = strdup(filePath);
+  image->residentLevel = 0;
+  image->resident = false;
+  image->failed = false;
+  image->lastUsedFrame = 0;
+  image->refCount = 1;
+  image->pixelData = NULL;
+  image->pixelDataMapped = false;
+  image->sourceModified = -1;
+  image->snapshotIndex = 0;
+  image->next = iconImageList;
+  iconImageList = image;
+  pendingIconImageCount++;
+  return image;
+}
+
+void releaseIconImage(struct IconImage* image)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (image == NULL || --image->refCount > 0) return;
+
+  struct IconImage** link = &iconImageList;
+  while (*link != image) link = &(*link)->next;
+  *link = image->next;
+  unloadIconImage(image);
+  if (!image->failed) pendingIconImageCount--;
+  if (!image->pixelDataMapped) free(image->pixelData);
+  free(image->path);
+  free(image);
+}
+
+bool loadPendingIconImage()
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  // Once everything is loaded an idle pass costs nothing
+  if (pendingIconImageCount <= 0) return false;
+
+  // Remotely every icon is uploaded up front so scrolling never waits on the network,
+  // the walk resumes at the last upload instead of starting over for every event
+  if (remoteDisplay)
+  {
+    int count = (int)getIconCount();
+    for (int step = 0; step < count; step++)
+    {
+      int index = (pendingIconCursor + step) % count;
+      struct IconImage* image = getIconByIndex(index)->image;
+      if (image != NULL && !image->resident && !image->failed)
+      {
+        pendingIconCursor = index;
+        makeIconImageResident(image);
+        return true;
+      }
+    }
+    pendingIconImageCount = 0;
+    return false;
+  }
+
+  // One decode per idle pass keeps scrolling responsive while icons stream in
+  int first = 0;
+  int last = -1;
+  calculateVisibleIconRange(&first, &last);
+  for (int index = first; index <= last; index++)
+  {
+    struct IconImage* image = getIconByIndex(index)->image;
+    if (image != NULL && !image->resident && !image->failed)
+    {
+      makeIconImageResident(image);
+      return true;
+    }
+  }
+  return false;
+}
+
+void makeIconImageResident(struct IconImage* image)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (image->resident || image->failed) return;
+  pendingIconImageCount--;
+
+  // Packed pixels survive eviction and come from the snapshot on a warm start
+  if (image->pixelData == NULL)
+  {
+    XImage* source = NULL;
+    XImage* shape = NULL;
+    XpmAttributes attributes;
+    attributes.valuemask = XpmReturnPixels;
+
+    image->sourceModified = readModificationTime(image->path);
+    int result = XpmReadFileToImage(display, image->path, &source, &shape, &attributes);
+    if (result != XpmSuccess || source == NULL)
+    {
+      fprintf(stderr, "Failed to load icon: %s!\n", image->path);
+      image->failed = true;
+      return;
+    }
+
+    // Every color is allocated with its own round trip
+    noteRoundTrips((int)attributes.npixels);
+    XpmFreeAttributes(&attributes);
+
+    buildIconMipChain(image, source, shape);
+    XDestroyImage(source);
+    if (shape != NULL) XDestroyImage(shape);
+    startupDecodedIcons++;
+  }
+  startupUploadedIcons++;
+
+  uploadIconImage(image);
+  image->resident = true;
+  residentIconImageBytes += calculateIconImageBytes(image->residentLevel);
+  evictIconImages();
+}
+
+void unloadIconImage(struct IconImage* image)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (!image->resident) return;
+  XFreePixmap(display, image->pixelMap);
+  XFreePixmap(display, image->mask);
+  image->resident = false;
+  pendingIconImageCount++;
+  residentIconImageBytes -= calculateIconImageBytes(image->residentLevel);
+}
+
+void evictIconImages()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // Images drawn in the current frame are on screen and never evicted
+  while (residentIconImageBytes > pixmapBudget)
+  {
+    struct IconImage* oldest = NULL;
+    struct IconImage* current = iconImageList;
+    while (current != NULL)
+    {
+      if (current->resident && current->lastUsedFrame < panelFrame)
+      {
+        if (oldest == NULL || current->lastUsedFrame < oldest->lastUsedFrame) oldest = current;
+      }
+      current = current->next;
+    }
+    if (oldest == NULL) return;
+    unloadIconImage(oldest);
+  }
+}
+
+unsigned long calculateIconImageBytes(int level)
+{
+  unsigned long size = calculateIconMipSize(level);
+  return size * size * 4 + (size + 7) / 8 * size;
+}
+
+void buildIconMipChain(struct IconImage* image, XImage* source, XImage* shape)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  float* sourcePixels = unpackIconPixels(source, shape);
+  int largestSize = calculateIconMipSize(ICON_MIP_LEVEL_COUNT - 1);
+  float* levelPixels = (float*)malloc(largestSize * largestSize * 4 * sizeof(float));
+  image->pixelData = (char*)calloc(calculatePackedIconBytes(), 1);
+  image->pixelDataMapped = false;
+
+  for (int level = 0; level < ICON_MIP_LEVEL_COUNT; level++)
+  {
+    size_t pixelOffset = 0;
+    size_t maskOffset = 0;
+    calculatePackedLevel(level, &pixelOffset, &maskOffset, NULL);
+    int size = calculateIconMipSize(level);
+    resampleIconPixels(sourcePixels, source->width, source->height, levelPixels, size);
+    packIconPixels(levelPixels, size, image->pixelData + pixelOffset, image->pixelData + maskOffset);
+  }
+
+  free(levelPixels);
+  free(sourcePixels);
+}
+
+float* unpackIconPixels(XImage* source, XImage* shape)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // Premultiplied RGBA, alpha is either 0 or 1 since XPM only knows "None"
+  Visual* visual = DefaultVisual(display, DefaultScreen(display));
+  unsigned long masks[3] = { visual->red_mask, visual->green_mask, visual->blue_mask };
+  int shifts[3];
+  float ranges[3];
+  for (int channel = 0; channel < 3; channel++)
+  {
+    shifts[channel] = masks[channel] ? __builtin_ctzl(masks[channel]) : 0;
+    ranges[channel] = masks[channel] ? (float)(masks[channel] >> shifts[channel]) : 1.0f;
+  }
+
+  float* pixels = (float*)malloc(source->width * source->height * 4 * sizeof(float));
+  for (int y = 0; y < source->height; y++)
+  {
+    for (int x = 0; x < source->width; x++)
+    {
+      float* pixel = pixels + (y * source->width + x) * 4;
+      float alpha = (shape == NULL || XGetPixel(shape, x, y)) ? 1.0f : 0.0f;
+      unsigned long value = XGetPixel(source, x, y);
+      for (int channel = 0; channel < 3; channel++)
+      {
+        pixel[channel] = alpha * ((value & masks[channel]) >> shifts[channel]) / ranges[channel];
+      }
+      pixel[3] = alpha;
+    }
+  }
+  return pixels;
+}
+
+void resampleIconPixels(const float* source, int sourceWidth, int sourceHeight, float* target, int targetSize)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // Area-averaging filter: every target pixel is the coverage-weighted mean of
+  // the source pixels under it, which keeps large downscales free of aliasing
+  float xStep = (float)sourceWidth / (float)targetSize;
+  float yStep = (float)sourceHeight / (float)targetSize;
+
+  for (int targetY = 0; targetY < targetSize; targetY++)
+  {
+    float top = targetY * yStep;
+    float bottom = top + yStep;
+    for (int targetX = 0; targetX < targetSize; targetX++)
+    {
+      float left = targetX * xStep;
+      float right = left + xStep;
+      float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+      float weightSum = 0.0f;
+
+      for (int y = (int)top; y < sourceHeight && y < bottom; y++)
+      {
+        float yWeight = fminf(bottom, y + 1.0f) - fmaxf(top, (float)y);
+        for (int x = (int)left; x < sourceWidth && x < right; x++)
+        {
+          float weight = yWeight * (fminf(right, x + 1.0f) - fmaxf(left, (float)x));
+          const float* pixel = source + (y * sourceWidth + x) * 4;
+          for (int channel = 0; channel < 4; channel++)
+          {
+            sum[channel] += weight * pixel[channel];
+          }
+          weightSum += weight;
+        }
+      }
+
+      float* out = target + (targetY * targetSize + targetX) * 4;
+      for (int channel = 0; channel < 4; channel++)
+      {
+        out[channel] = weightSum > 0.0f ? sum[channel] / weightSum : 0.0f;
+      }
+    }
+  }
+}
+
+void packIconPixels(const float* pixels, int size, char* pixelData, char* maskData)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  int bytesPerLine = (size * packedBitsPerPixel + 31) / 32 * 4;
+  int screenNum = DefaultScreen(display);
+  XImage* image = XCreateImage(display, DefaultVisual(display, screenNum), packedDepth, ZPixmap, 0, pixelData, size, size, 32, bytesPerLine);
+  int maskStride = (size + 7) / 8;
+
+  for (int y = 0; y < size; y++)
+  {
+    for (int x = 0; x < size; x++)
+    {
+      const float* pixel = pixels + (y * size + x) * 4;
+      float alpha = pixel[3];
+      uint8_t rgb[3] = { 0, 0, 0 };
+      if (alpha > 0.0f)
+      {
+        for (int channel = 0; channel < 3; channel++)
+        {
+          rgb[channel] = (uint8_t)(fminf(pixel[channel] / alpha, 1.0f) * 255.0f + 0.5f);
+        }
+      }
+      XPutPixel(image, x, y, calculateRGB(rgb[0], rgb[1], rgb[2]));
+      if (alpha >= 0.5f) maskData[y * maskStride + x / 8] |= 1 << (x % 8);
+    }
+  }
+
+  // The pixel data belongs to the icon image, not to the XImage
+  image->data = NULL;
+  XDestroyImage(image);
+}
+
+void uploadIconImage(struct IconImage* image)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // The whole chain stays packed on the client, the server only holds the level being drawn
+  int screenNum = DefaultScreen(display);
+  int level = layout.iconMipLevel;
+  size_t pixelOffset = 0;
+  size_t maskOffset = 0;
+  int bytesPerLine = 0;
+  calculatePackedLevel(level, &pixelOffset, &maskOffset, &bytesPerLine);
+  int size = calculateIconMipSize(level);
+
+  XImage* levelImage = XCreateImage(
+    display,
+    DefaultVisual(display, screenNum),
+    packedDepth,
+    ZPixmap,
+    0,
+    image->pixelData + pixelOffset,
+    size,
+    size,
+    32,
+    bytesPerLine
+  );
+  image->pixelMap = XCreatePixmap(display, panelWindow, size, size, packedDepth);
+  XPutImage(display, image->pixelMap, panelGC, levelImage, 0, 0, 0, 0, size, size);
+  levelImage->data = NULL;
+  XDestroyImage(levelImage);
+
+  image->mask = XCreateBitmapFromData(display, panelWindow, image->pixelData + maskOffset, size, size);
+  image->residentLevel = level;
+}
+
+size_t calculatePackedIconBytes()
+{
+  size_t pixelOffset = 0;
+  size_t maskOffset = 0;
+  calculatePackedLevel(ICON_MIP_LEVEL_COUNT, &pixelOffset, &maskOffset, NULL);
+  return pixelOffset;
+}
+
+void calculatePackedLevel(int level, size_t* pixelOffset, size_t* maskOffset, int* bytesPerLine)
+{
+  // Levels are stored one after another as a ZPixmap followed by its XBM mask
+  size_t offset = 0;
+  for (int current = 0; current <= level; current++)
+  {
+    if (current == ICON_MIP_LEVEL_COUNT) break;
+    int size = calculateIconMipSize(current);
+    int lineBytes = (size * packedBitsPerPixel + 31) / 32 * 4;
+    if (current == level)
+    {
+      *pixelOffset = offset;
+      *maskOffset = offset + (size_t)lineBytes * size;
+      if (bytesPerLine != NULL) *bytesPerLine = lineBytes;
+      return;
+    }
+    offset += (size_t)lineBytes * size + (size_t)((size + 7) / 8) * size;
+  }
+  *pixelOffset = offset;
+  *maskOffset = offset;
+}
+
+struct IconNode* createIcon(const char* name, const char* command)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  struct IconNode* icon = allocateIconNode();
+  icon->image = NULL;
+  icon->name = internString(name, ICON_NAME_LIMIT);
+  icon->command = internString(command, INTERNED_STRING_LIMIT);
+  icon->tooltip = NULL;
+  icon->tooltipWindow = None;
+  icon->id = -1;
+  icon->next = NULL;
+  return icon;
+}
+
+void freeIconTooltip(struct IconNode* icon)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (icon->tooltip == NULL) return;
+  if (tooltipWindow == icon->tooltipWindow)
+  {
+    tooltipWindow = None;
+    tooltipShown = false;
+  }
+  XDestroyWindow(display, icon->tooltipWindow);
+  freeTextLabel(icon->tooltip);
+  icon->tooltip = NULL;
+  icon->tooltipWindow = None;
+}
+
+void destroyIcon(struct IconNode* icon)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  releaseString(icon->name);
+  releaseString(icon->command);
+  freeIconTooltip(icon);
+  releaseIconImage(icon->image);
+  releaseIconId(icon->id);
+  releaseIconNode(icon);
+}
+
+void addIcon(const char* name, const char* command)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  addIconWithId(allocateIconId(), name, command, DEFAULT_ICON_PATH);
+}
+
+void addIconWithId(int id, const char* name, const char* command, const char* iconPath)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // The ID must already be reserved in the bitmap
+  struct IconNode* newNode = createIcon(name, command);
+  newNode->id = id;
+  iconIdTable[id] = newNode;
+
+  newNode->image = loadIconImage(iconPath);
+
+  if (iconList == NULL)
+  {
+    iconList = newNode;
+  }
+  else
+  {
+    iconTable[iconTableCount - 1]->next = newNode;
+  }
+  rebuildIconTable();
+}
+
+struct IconNode* getIconByIndex(int index)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (index < 0 || index >= (int)iconTableCount) return NULL;
+  return iconTable[index];
+}
+
+void rebuildIconTable()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  unsigned int count = 0;
+  struct IconNode* current = iconList;
+  while (current != NULL)
+  {
+    if (count == iconTableCapacity)
+    {
+      iconTableCapacity = iconTableCapacity == 0 ? 32 : iconTableCapacity * 2;
+      iconTable = (struct IconNode**)realloc(iconTable, iconTableCapacity * sizeof(struct IconNode*));
+    }
+    iconTable[count] = current;
+    count++;
+    current = current->next;
+  }
+  iconTableCount = count;
+}
+
+unsigned int getIconCount()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  return iconTableCount;
+}
+
+void moveIconToLeftByIndex(int index)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (index <= 0 || iconList == NULL || iconList->next == NULL) return;
+
+  struct IconNode* previous = NULL;
+  struct IconNode* current = iconList;
+  struct IconNode* previousPrevious = NULL;
+
+  int currentIndex = 0;
+  while (current != NULL && currentIndex != index)
+  {
+    previousPrevious = previous;
+    previous = current;
+    current = current->next;
+    currentIndex++;
+  }
+
+  if (current == NULL) return;
+
+  if (previousPrevious != NULL)
+  {
+    previousPrevious->next = current;
+  }
+  else
+  {
+    iconList = current;
+  }
+
+  previous->next = current->next;
+  current->next = previous;
+  rebuildIconTable();
+}
+
+void moveIconToRightByIndex(int index)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (iconList == NULL || iconList->next == NULL) return;
+
+  struct IconNode* previous = NULL;
+  struct IconNode* current = iconList;
+
+  int currentIndex = 0;
+
+  while (current != NULL && currentIndex < index)
+  {
+    previous = current;
+    current = current->next;
+    currentIndex++;
+  }
+
+  if (current == NULL || current->next == NULL) return;
+
+  struct IconNode* nextNode = current->next;
+
+  if (previous != NULL)
+  {
+    previous->next = nextNode;
+  }
+  else
+  {
+    iconList = nextNode;
+  }
+
+  current->next = nextNode->next;
+  nextNode->next = current;
+  rebuildIconTable();
+}
+
+void moveIconToIndex(int index, int targetIndex)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  struct IconNode* icon = getIconByIndex(index);
+  if (icon == NULL || targetIndex < 0 || targetIndex >= (int)iconTableCount || targetIndex == index) return;
+
+  // Unlink once and relink once, the table gives both neighbours directly
+  if (index == 0) iconList = icon->next;
+  else iconTable[index - 1]->next = icon->next;
+
+  if (targetIndex == 0)
+  {
+    icon->next = iconList;
+    iconList = icon;
+  }
+  else
+  {
+    struct IconNode* previous = iconTable[targetIndex < index ? targetIndex - 1 : targetIndex];
+    icon->next = previous->next;
+    previous->next = icon;
+  }
+  rebuildIconTable();
+}
+
+void removeIconByIndex(int index)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  struct IconNode* icon = getIconByIndex(index);
+  if (icon == NULL) return;
+  if (index == 0)
+  {
+    iconList = icon->next;
+  }
+  else
+  {
+    iconTable[index - 1]->next = icon->next;
+  }
+  destroyIcon(icon);
+  rebuildIconTable();
+}
+
+int allocateIconId()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // Lowest free ID: first word with a clear bit, then its lowest clear bit
+  for (int word = 0; word < iconIdWordCount; word++)
+  {
+    if (~iconIdBitmap[word] != 0)
+    {
+      int id = word * 64 + __builtin_ctzll(~iconIdBitmap[word]);
+      reserveIconId(id);
+      return id;
+    }
+  }
+  int id = iconIdWordCount * 64;
+  reserveIconId(id);
+  return id;
+}
+
+bool reserveIconId(int id)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  // IDs come from files other tools edit, an out of range one is reassigned by the caller
+  if (id < 0 || id >= ICON_ID_LIMIT) return false;
+  int word = id / 64;
+  if (word >= iconIdWordCount)
   {
-    renderIconPixelMapAtIndex(index);
-    index++;
-    current = current->next;
+    int wordCount = iconIdWordCount == 0 ? 4 : iconIdWordCount;
+    while (wordCount <= word) wordCount *= 2;
+    size_t addedWords = (size_t)(wordCount - iconIdWordCount);
+    iconIdBitmap = (uint64_t*)realloc(iconIdBitmap, (size_t)wordCount * sizeof(uint64_t));
+    iconIdTable = (struct IconNode**)realloc(iconIdTable, (size_t)wordCount * 64 * sizeof(struct IconNode*));
+    memset(iconIdBitmap + iconIdWordCount, 0, addedWords * sizeof(uint64_t));
+    memset(iconIdTable + (size_t)iconIdWordCount * 64, 0, addedWords * 64 * sizeof(struct IconNode*));
+    iconIdWordCount = wordCount;
   }
+  uint64_t bit = (uint64_t)1 << (id % 64);
+  if (iconIdBitmap[word] & bit) return false;
+  iconIdBitmap[word] |= bit;
+  return true;
 }
 
-void renderIconIdAtIndex(int index)
+void releaseIconId(int id)
 {
-  if (!DEBUG_RENDER_ICON_IDS) return;
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  struct IconNode* icon = getIconByIndex(index);
-  if (icon == NULL) return;
-  XSetForeground(display, panelGC, cMenuForeground);
-  int iconX = index * (ICON_BOX_SIZE + GAP_SIZE) + GAP_SIZE;
-  char* idBuffer = (char*)malloc(sizeof(4));
-  snprintf(idBuffer, 4, "%d", icon->id);
-  XDrawString(display, panelWindow, panelGC, iconX + 2, GAP_SIZE + 10 + 2, idBuffer, strlen(idBuffer));
-  free(idBuffer);
+  if (id < 0 || id / 64 >= iconIdWordCount) return;
+  iconIdBitmap[id / 64] &= ~((uint64_t)1 << (id % 64));
+  iconIdTable[id] = NULL;
 }
 
-void renderIconIds(struct IconNode* iconList)
+struct IconNode* getIconById(int id)
 {
-  if (!DEBUG_RENDER_ICON_IDS) return;
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  if (iconList == NULL) return;
+  if (id < 0 || id / 64 >= iconIdWordCount) return NULL;
+  return iconIdTable[id];
+}
 
-  struct IconNode* current = iconList;
-  int index = 0;
+bool resolveStatePath(char* buffer, size_t size, const char* envName, const char* fallback, const char* fileName)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  const char* base = getenv(envName);
+  const char* home = getenv("HOME");
+  int length;
+  if (base != NULL && base[0] == '/') length = snprintf(buffer, size, "%s/u16panel", base);
+  else if (home != NULL) length = snprintf(buffer, size, "%s/%s/u16panel", home, fallback);
+  else return false;
+  if (length < 0 || (size_t)length >= size) return false;
 
-  while (current != NULL)
+  // Create every missing directory along the way
+  for (char* slash = strchr(buffer + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/'))
   {
-    renderIconIdAtIndex(index);
-    index++;
-    current = current->next;
+    *slash = '\0';
+    mkdir(buffer, 0755);
+    *slash = '/';
   }
+  mkdir(buffer, 0755);
+
+  length = snprintf(buffer + length, size - length, "/%s", fileName) + length;
+  return length > 0 && (size_t)length < size;
 }
 
-void renderMenuHoverAtIndex(int index)
+bool loadPins()
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  XSetForeground(display, menuGC, cMenuHover);
-  XFillRectangle(
-    display,
-    menuWindow,
-    menuGC,
-    0,
-    index * ITEM_HEIGHT,
-    ITEM_WIDTH,
-    ITEM_HEIGHT
-  );
-  XSetForeground(display, menuGC, cMenuForeground);
+  char path[PATH_MAX];
+  if (!resolveStatePath(path, sizeof(path), "XDG_CONFIG_HOME", ".config", PINS_FILE_NAME)) return false;
+  FILE* file = fopen(path, "r");
+  if (file == NULL) return false;
+
+  // One entry per line: id, name, command and icon path separated by tabs
+  char line[2 * PATH_MAX];
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    line[strcspn(line, "\n")] = '\0';
+    char* fields[4];
+    int fieldCount = 0;
+    char* cursor = line;
+    while (fieldCount < 4 && cursor != NULL)
+    {
+      fields[fieldCount++] = cursor;
+      cursor = strchr(cursor, '\t');
+      if (cursor != NULL) *cursor++ = '\0';
+    }
+    if (fieldCount < 4) continue;
+    long parsedId = strtol(fields[0], NULL, 10);
+    int id = parsedId >= 0 && parsedId < ICON_ID_LIMIT ? (int)parsedId : -1;
+    if (!reserveIconId(id)) id = allocateIconId();
+    addIconWithId(id, fields[1], fields[2], fields[3]);
+  }
+  fclose(file);
+  return true;
 }
 
-void renderMenuItems(const char** menuItems, int itemCount)
+void savePins()
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  for (int i = 0; i < itemCount; i++)
+  char path[PATH_MAX];
+  char temporaryPath[PATH_MAX + 8];
+  if (!resolveStatePath(path, sizeof(path), "XDG_CONFIG_HOME", ".config", PINS_FILE_NAME)) return;
+  snprintf(temporaryPath, sizeof(temporaryPath), "%s.new", path);
+  FILE* file = fopen(temporaryPath, "w");
+  if (file == NULL)
   {
-    XDrawString(display, menuWindow, menuGC, 6, 16 + i * ITEM_HEIGHT, menuItems[i], strlen(menuItems[i]));
+    fprintf(stderr, "Cannot write pins: %s!\n", temporaryPath);
+    return;
+  }
+  for (unsigned int index = 0; index < iconTableCount; index++)
+  {
+    struct IconNode* icon = iconTable[index];
+    fprintf(file, "%d\t%s\t%s\t%s\n", icon->id, icon->name, icon->command, icon->image != NULL ? icon->image->path : DEFAULT_ICON_PATH);
   }
+  // Rename over the old file so a crash never leaves it half written
+  if (fclose(file) == 0) rename(temporaryPath, path);
+  // The snapshot carries every image, so a burst of reorders writes it once
+  if (timerDeadlines[TIMER_SNAPSHOT_SAVE] == 0) armTimer(TIMER_SNAPSHOT_SAVE, SNAPSHOT_SAVE_DELAY_MS * 1000);
 }
 
-int calculatePanelWidth(int iconCount)
+int64_t readModificationTime(const char* path)
 {
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  return GAP_SIZE * 2 + (iconCount - 1) * GAP_SIZE + iconCount * ICON_BOX_SIZE;
+  struct stat status;
+  if (stat(path, &status) != 0) return -1;
+  return (int64_t)status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
 }
 
-int calculateIconIndexFromMouseX(int relMouseX, int iconCount)
+bool loadSnapshot()
 {
-  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
-  int iconIndex = 0;
-  if (relMouseX < 0) { return -1; }
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  char path[PATH_MAX];
+  char pinsPath[PATH_MAX];
+  if (!resolveStatePath(path, sizeof(path), "XDG_CACHE_HOME", ".cache", SNAPSHOT_FILE_NAME)) return false;
+  if (!resolveStatePath(pinsPath, sizeof(pinsPath), "XDG_CONFIG_HOME", ".config", PINS_FILE_NAME)) return false;
+
+  int file = open(path, O_RDONLY);
+  if (file < 0) return false;
+  struct stat status;
+  if (fstat(file, &status) != 0 || (size_t)status.st_size < sizeof(struct SnapshotHeader))
+  {
+    close(file);
+    return false;
+  }
+  void* mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if (mapping == MAP_FAILED) return false;
+
+  const char* data = (const char*)mapping;
+  size_t size = status.st_size;
+  const struct SnapshotHeader* header = (const struct SnapshotHeader*)data;
   if (
-    relMouseX > GAP_SIZE + GAP_SIZE / 2 + ICON_BOX_SIZE
+    memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+    header->version != SNAPSHOT_VERSION ||
+    header->depth != (uint32_t)packedDepth ||
+    header->bitsPerPixel != (uint32_t)packedBitsPerPixel ||
+    header->byteOrder != (uint32_t)packedByteOrder ||
+    header->iconSize != (uint32_t)ICON_SIZE ||
+    header->fileSize != size ||
+    header->pinsModified != readModificationTime(pinsPath) ||
+    header->entriesOffset + (uint64_t)header->entryCount * sizeof(struct SnapshotEntry) > size ||
+    header->imagesOffset + (uint64_t)header->imageCount * sizeof(struct SnapshotImage) > size ||
+    header->stringsOffset > size
   )
-  { iconIndex = (relMouseX - GAP_SIZE / 2) / (ICON_BOX_SIZE + GAP_SIZE); }
-  if (iconIndex == iconCount) iconIndex--;
-  return iconIndex;
+  {
+    munmap(mapping, size);
+    return false;
+  }
+
+  const struct SnapshotEntry* entries = (const struct SnapshotEntry*)(data + header->entriesOffset);
+  const struct SnapshotImage* images = (const struct SnapshotImage*)(data + header->imagesOffset);
+  size_t packedBytes = calculatePackedIconBytes();
+  for (uint32_t index = 0; index < header->entryCount; index++)
+  {
+    const struct SnapshotEntry* entry = &entries[index];
+    if (entry->imageIndex >= header->imageCount) continue;
+    const struct SnapshotImage* snapshotImage = &images[entry->imageIndex];
+    const char* name = readSnapshotString(data, size, header->stringsOffset, entry->nameOffset);
+    const char* command = readSnapshotString(data, size, header->stringsOffset, entry->commandOffset);
+    const char* iconPath = readSnapshotString(data, size, header->stringsOffset, snapshotImage->pathOffset);
+    if (name == NULL || command == NULL || iconPath == NULL) continue;
+
+    int id = entry->id;
+    if (!reserveIconId(id)) id = allocateIconId();
+    addIconWithId(id, name, command, iconPath);
+
+    // Pixels are only trusted while the source file is unchanged
+    struct IconImage* image = iconTable[iconTableCount - 1]->image;
+    if (
+      image->pixelData == NULL &&
+      snapshotImage->pixelBytes == packedBytes &&
+      snapshotImage->pixelOffset + packedBytes <= size &&
+      snapshotImage->sourceModified == readModificationTime(iconPath)
+    )
+    {
+      image->pixelData = (char*)(data + snapshotImage->pixelOffset);
+      image->pixelDataMapped = true;
+      image->sourceModified = snapshotImage->sourceModified;
+    }
+  }
+
+  // Icons keep pointing into the mapping, so it stays until exit
+  snapshotData = data;
+  snapshotSize = size;
+  return true;
 }
 
-int calculateItemIndexFromMouseY(int relMouseY, int itemCount)
+const char* readSnapshotString(const char* data, size_t size, uint64_t stringsOffset, uint64_t offset)
 {
-  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
-  if (relMouseY <= ITEM_HEIGHT) return 0;
-  if (relMouseY < 0 || relMouseY > ITEM_HEIGHT * itemCount) return -1;
-  return relMouseY / ITEM_HEIGHT;
+  if (stringsOffset + offset >= size) return NULL;
+  const char* text = data + stringsOffset + offset;
+  if (memchr(text, '\0', size - stringsOffset - offset) == NULL) return NULL;
+  return text;
 }
 
-void loadPixelMap(Pixmap* map, Pixmap* mask, const char* filePath, int* width, int* height)
+void saveSnapshot()
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  char path[PATH_MAX];
+  char temporaryPath[PATH_MAX + 8];
+  char pinsPath[PATH_MAX];
+  if (!resolveStatePath(path, sizeof(path), "XDG_CACHE_HOME", ".cache", SNAPSHOT_FILE_NAME)) return;
+  if (!resolveStatePath(pinsPath, sizeof(pinsPath), "XDG_CONFIG_HOME", ".config", PINS_FILE_NAME)) return;
+  snprintf(temporaryPath, sizeof(temporaryPath), "%s.new", path);
 
-  XpmAttributes attributes;
-  attributes.valuemask = XpmReturnPixels;
-
-  int result = XpmReadFileToPixmap(display, panelWindow, filePath, map, mask, &attributes);
-  if (result == XpmSuccess)
+  // Number the images in use, every entry refers to its image by that index
+  uint32_t imageCount = 0;
+  for (struct IconImage* image = iconImageList; image != NULL; image = image->next)
   {
-    *width = attributes.width;
-    *height = attributes.height;
-    return;
+    image->snapshotIndex = imageCount++;
   }
-  fprintf(stderr, "Failed to load icon: %s!\n", filePath);
-}
 
-void scalePixelMap(Pixmap* baseMap, Pixmap* baseMask, int baseWidth, int baseHeight, int newWidth, int newHeight)
-{
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  size_t stringsCapacity = 4096;
+  size_t stringsSize = 0;
+  char* strings = (char*)malloc(stringsCapacity);
+  struct SnapshotEntry* entries = (struct SnapshotEntry*)calloc(iconTableCount + 1, sizeof(struct SnapshotEntry));
+  struct SnapshotImage* images = (struct SnapshotImage*)calloc(imageCount + 1, sizeof(struct SnapshotImage));
+  size_t packedBytes = calculatePackedIconBytes();
 
-  Pixmap scaledPixmap = XCreatePixmap(display, panelWindow, newWidth, newHeight, DefaultDepth(display, DefaultScreen(display)));
-  Pixmap scaledMask = XCreatePixmap(display, panelWindow, newWidth, newHeight, 1);
-  GC gc = XCreateGC(display, scaledPixmap, 0, NULL);
-  GC maskGC = XCreateGC(display, scaledMask, 0, NULL);
+  struct SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.depth = packedDepth;
+  header.bitsPerPixel = packedBitsPerPixel;
+  header.byteOrder = packedByteOrder;
+  header.iconSize = ICON_SIZE;
+  header.entryCount = iconTableCount;
+  header.imageCount = imageCount;
+  header.pinsModified = readModificationTime(pinsPath);
+  header.entriesOffset = sizeof(header);
+  header.imagesOffset = header.entriesOffset + iconTableCount * sizeof(struct SnapshotEntry);
+  header.stringsOffset = header.imagesOffset + imageCount * sizeof(struct SnapshotImage);
 
-  float xScale = (float)newWidth / (float)baseWidth;
-  float yScale = (float)newHeight / (float)baseHeight;
+  for (unsigned int index = 0; index < iconTableCount; index++)
+  {
+    struct IconNode* icon = iconTable[index];
+    entries[index].id = icon->id;
+    entries[index].imageIndex = icon->image != NULL ? icon->image->snapshotIndex : UINT32_MAX;
+    entries[index].nameOffset = appendSnapshotString(&strings, &stringsSize, &stringsCapacity, icon->name);
+    entries[index].commandOffset = appendSnapshotString(&strings, &stringsSize, &stringsCapacity, icon->command);
+  }
+
+  for (struct IconImage* image = iconImageList; image != NULL; image = image->next)
+  {
+    struct SnapshotImage* snapshotImage = &images[image->snapshotIndex];
+    snapshotImage->pathOffset = appendSnapshotString(&strings, &stringsSize, &stringsCapacity, image->path);
+  }
+  uint64_t pixelOffset = (header.stringsOffset + stringsSize + 15) & ~(uint64_t)15;
+  for (struct IconImage* image = iconImageList; image != NULL; image = image->next)
+  {
+    struct SnapshotImage* snapshotImage = &images[image->snapshotIndex];
+    snapshotImage->sourceModified = image->sourceModified;
+    if (image->pixelData == NULL) continue;
+    snapshotImage->pixelOffset = pixelOffset;
+    snapshotImage->pixelBytes = packedBytes;
+    pixelOffset += (packedBytes + 15) & ~(size_t)15;
+  }
+  header.fileSize = pixelOffset;
 
-  for (int y = 0; y < newHeight; y++)
+  FILE* file = fopen(temporaryPath, "w");
+  if (file != NULL)
   {
-    for (int x = 0; x < newWidth; x++)
+    static const char padding[16];
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(entries, sizeof(struct SnapshotEntry), iconTableCount, file);
+    fwrite(images, sizeof(struct SnapshotImage), imageCount, file);
+    fwrite(strings, 1, stringsSize, file);
+    fwrite(padding, 1, (16 - (header.stringsOffset + stringsSize) % 16) % 16, file);
+    for (struct IconImage* image = iconImageList; image != NULL; image = image->next)
     {
-      int sourceX = (int)(x / xScale);
-      int sourceY = (int)(y / yScale);
-      XCopyArea(display, *baseMap, scaledPixmap, gc, sourceX, sourceY, 1, 1, x, y);
-      XCopyArea(display, *baseMask, scaledMask, maskGC, sourceX, sourceY, 1, 1, x, y);
+      if (image->pixelData == NULL) continue;
+      fwrite(image->pixelData, 1, packedBytes, file);
+      fwrite(padding, 1, (16 - packedBytes % 16) % 16, file);
     }
+    if (fclose(file) == 0) rename(temporaryPath, path);
+  }
+  else
+  {
+    fprintf(stderr, "Cannot write snapshot: %s!\n", temporaryPath);
   }
 
-  XFreeGC(display, gc);
-  XFreeGC(display, maskGC);
-  XFreePixmap(display, *baseMap);
-  XFreePixmap(display, *baseMask);
-  *baseMap = scaledPixmap;
-  *baseMask = scaledMask;
+  free(strings);
+  free(entries);
+  free(images);
 }
 
-struct IconNode* createIcon(const char* name)
+uint64_t appendSnapshotString(char** strings, size_t* size, size_t* capacity, const char* text)
 {
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  char* allocatedName = malloc(ICON_NAME_LIMIT * sizeof(char));
-  strcpy(allocatedName, name);
-  struct IconNode* icon = (struct IconNode*)malloc(sizeof(struct IconNode));
-  icon->pixelMap = None;
-  icon->mask = None;
-  icon->name = allocatedName;
-  icon->id = -1;
-  icon->next = NULL;
-  return icon;
+  size_t length = strlen(text) + 1;
+  while (*size + length > *capacity)
+  {
+    *capacity *= 2;
+    *strings = (char*)realloc(*strings, *capacity);
+  }
+  memcpy(*strings + *size, text, length);
+  uint64_t offset = *size;
+  *size += length;
+  return offset;
 }
 
-void addIcon(const char* name)
+void* allocateFromArena(size_t size)
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  struct IconNode* newNode = createIcon(name);
-  newNode->id = generateIconId();
-
-  Pixmap map = None;
-  Pixmap mask = None;
-  int mapWidth = 0;
-  int mapHeight = 0;
-  loadPixelMap(&map, &mask, "icon.xpm", &mapWidth, &mapHeight);
-  scalePixelMap(&map, &mask, mapWidth, mapHeight, ICON_SIZE, ICON_SIZE);
-  newNode->pixelMap = map;
-  newNode->mask = mask;
- 
-  if (iconList == NULL)
-  {
-    iconList = newNode;
-    return;
-  }
-  struct IconNode* current = iconList;
-  while (current->next != NULL)
+  size = (size + 15) & ~(size_t)15;
+  if (arenaChunkList == NULL || arenaChunkList->used + size > arenaChunkList->size)
   {
-    current = current->next;
+    size_t chunkSize = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+    struct ArenaChunk* chunk = (struct ArenaChunk*)malloc(sizeof(struct ArenaChunk) + chunkSize);
+    chunk->size = chunkSize;
+    chunk->used = 0;
+    chunk->next = arenaChunkList;
+    arenaChunkList = chunk;
   }
-  current->next = newNode;
+  void* memory = arenaChunkList->data + arenaChunkList->used;
+  arenaChunkList->used += size;
+  return memory;
 }
 
-struct IconNode* getIconByIndex(int index)
+const char* internString(const char* text, size_t limit)
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  int currentIndex = 0;
-  if (iconList == NULL) return NULL;
-  struct IconNode* current = iconList;
+  size_t length = strnlen(text, limit - 1);
+  // Do not cut a UTF-8 sequence in half when truncating
+  if (length == limit - 1) while (length > 0 && ((unsigned char)text[length] & 0xc0) == 0x80) length--;
+
+  unsigned int hash = calculateStringHash(text, length);
+  unsigned int bucket = hash % INTERNED_STRING_BUCKET_COUNT;
+  struct InternedString* current = internedStringBuckets[bucket];
   while (current != NULL)
   {
-    if (currentIndex == index)
+    if (current->hash == hash && strncmp(current->text, text, length) == 0 && current->text[length] == '\0')
     {
-      return current;
+      current->refCount++;
+      return current->text;
     }
     current = current->next;
-    currentIndex++;
   }
-  return NULL;
+
+  // Reuse a released string of the same size class before growing the arena
+  int sizeClass = 0;
+  while ((INTERNED_STRING_MIN_CAPACITY << sizeClass) < length + 1) sizeClass++;
+  struct InternedString* string = freeStringLists[sizeClass];
+  if (string != NULL)
+  {
+    freeStringLists[sizeClass] = string->next;
+  }
+  else
+  {
+    string = (struct InternedString*)allocateFromArena(sizeof(struct InternedString) + (INTERNED_STRING_MIN_CAPACITY << sizeClass));
+    string->sizeClass = sizeClass;
+  }
+  memcpy(string->text, text, length);
+  string->text[length] = '\0';
+  string->hash = hash;
+  string->refCount = 1;
+  string->next = internedStringBuckets[bucket];
+  internedStringBuckets[bucket] = string;
+  return string->text;
 }
 
-unsigned int getIconCount()
+const char* findInternedString(const char* text)
 {
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  int count = 0;
-  if (iconList == NULL) return count;
-  struct IconNode* current = iconList;
+  // Looks a string up without taking a reference, NULL when it was never interned
+  size_t length = strlen(text);
+  unsigned int hash = calculateStringHash(text, length);
+  struct InternedString* current = internedStringBuckets[hash % INTERNED_STRING_BUCKET_COUNT];
   while (current != NULL)
   {
-    count++;
+    if (current->hash == hash && strcmp(current->text, text) == 0) return current->text;
     current = current->next;
   }
-  return count;
+  return NULL;
 }
 
-void moveIconToLeftByIndex(int index)
+unsigned int calculateStringHash(const char* text, size_t length)
+{
+  unsigned int hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+  return hash;
+}
+
+void releaseString(const char* text)
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  if (index <= 0 || iconList == NULL || iconList->next == NULL) return;
+  if (text == NULL) return;
+  struct InternedString* string = (struct InternedString*)(text - offsetof(struct InternedString, text));
+  if (--string->refCount > 0) return;
 
-  struct IconNode* previous = NULL;
-  struct IconNode* current = iconList;
-  struct IconNode* previousPrevious = NULL;
+  struct InternedString** link = &internedStringBuckets[string->hash % INTERNED_STRING_BUCKET_COUNT];
+  while (*link != string) link = &(*link)->next;
+  *link = string->next;
+  string->next = freeStringLists[string->sizeClass];
+  freeStringLists[string->sizeClass] = string;
+}
 
-  int currentIndex = 0;
-  while (current != NULL && currentIndex != index)
+struct IconNode* allocateIconNode()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (freeIconNodeList == NULL)
   {
-    previousPrevious = previous;
-    previous = current;
-    current = current->next;
-    currentIndex++;
+    struct IconNode* slab = (struct IconNode*)allocateFromArena(ICON_SLAB_SIZE * sizeof(struct IconNode));
+    for (int i = 0; i < ICON_SLAB_SIZE; i++)
+    {
+      slab[i].next = freeIconNodeList;
+      freeIconNodeList = &slab[i];
+    }
   }
+  struct IconNode* icon = freeIconNodeList;
+  freeIconNodeList = icon->next;
+  return icon;
+}
 
-  if (current == NULL) return;
+void releaseIconNode(struct IconNode* icon)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  icon->next = freeIconNodeList;
+  freeIconNodeList = icon;
+}
 
-  if (previousPrevious != NULL)
+long readResidentSetSize()
+{
+  long pages = 0;
+  long residentPages = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == NULL) return -1;
+  if (fscanf(statm, "%ld %ld", &pages, &residentPages) != 2) residentPages = -1;
+  fclose(statm);
+  return residentPages * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+void runSoakTest(int cycles, int screenWidth, int screenHeight)
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  char name[32];
+  char sourcePath[PATH_MAX];
+  char iconPath[PATH_MAX + 32];
+  char directory[] = "/tmp/u16soakXXXXXX";
+  if (realpath(DEFAULT_ICON_PATH, sourcePath) == NULL || mkdtemp(directory) == NULL)
   {
-    previousPrevious->next = current;
+    fprintf(stderr, "Cannot prepare soak icons: %s!\n", DEFAULT_ICON_PATH);
+    return;
   }
-  else
+  for (int cycle = 1; cycle <= cycles; cycle++)
   {
-    iconList = current;
+    // Unique names exercise string recycling, unique paths give every cycle
+    // its own image, so its pixmaps are uploaded and freed with the icon
+    snprintf(name, sizeof(name), "Soak %d", cycle);
+    snprintf(iconPath, sizeof(iconPath), "%s/icon-%d.xpm", directory, cycle);
+    if (symlink(sourcePath, iconPath) != 0) break;
+    int id = allocateIconId();
+    addIconWithId(id, name, "alacritty", iconPath);
+    makeIconImageResident(getIconById(id)->image);
+    removeIconByIndex(getIconCount() - 1);
+    unlink(iconPath);
+    if (cycle % (cycles / 10 > 0 ? cycles / 10 : 1) == 0)
+    {
+      refreshPanel(getIconCount(), screenWidth, screenHeight);
+      while (loadPendingIconImage()) renderPanel(-1);
+      XSync(display, false);
+      long serverBytes = readServerPixmapBytes();
+      char serverUsage[32];
+      if (serverBytes < 0) snprintf(serverUsage, sizeof(serverUsage), "unknown (no XRes)");
+      else snprintf(serverUsage, sizeof(serverUsage), "%ld KiB", serverBytes / 1024);
+      printf(
+        "Soak cycle %d: client RSS %ld KiB, server pixmaps %s, %u icons\n",
+        cycle,
+        readResidentSetSize(),
+        serverUsage,
+        getIconCount()
+      );
+    }
   }
-
-  previous->next = current->next;
-  current->next = previous;
+  rmdir(directory);
 }
 
-void moveIconToRightByIndex(int index)
+long readServerPixmapBytes()
 {
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  if (iconList == NULL || iconList->next == NULL) return;
-
-  struct IconNode* previous = NULL;
-  struct IconNode* current = iconList;
-
-  int currentIndex = 0;
-
-  while (current != NULL && currentIndex < index)
+  // Asks the server itself, XRes is loaded on demand so it stays optional
+  static Status (*queryPixmapBytes)(Display*, XID, unsigned long*) = NULL;
+  static bool resolved = false;
+  if (!resolved)
   {
-    previous = current;
-    current = current->next;
-    currentIndex++;
+    void* library = dlopen("libXRes.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (library != NULL) *(void**)&queryPixmapBytes = dlsym(library, "XResQueryClientPixmapBytes");
+    resolved = true;
   }
+  unsigned long bytes = 0;
+  if (queryPixmapBytes == NULL || !queryPixmapBytes(display, panelWindow, &bytes)) return -1;
+  return (long)bytes;
+}
 
-  if (current == NULL || current->next == NULL) return;
+uint64_t currentTime()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
 
-  struct IconNode* nextNode = current->next;
+uint64_t currentCpuTime()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
 
-  if (previous != NULL)
-  {
-    previous->next = nextNode;
-  }
-  else
-  {
-    iconList = nextNode;
-  }
+void armTimer(int timer, uint64_t delay)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  timerDeadlines[timer] = currentTime() + delay;
+}
 
-  current->next = nextNode->next;
-  nextNode->next = current;
+void armTimerAt(int timer, uint64_t deadline)
+{
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  timerDeadlines[timer] = deadline;
 }
 
-void removeIconByIndex(int index)
+void disarmTimer(int timer)
 {
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  struct IconNode* temporary = iconList;
-  if (temporary == NULL) return;
-  if (index == 0)
-  {
-    temporary = temporary->next;
-    free(iconList);
-    iconList = temporary;
-    return;
-  }
-  int currentIndex = 0;
-  struct IconNode* previous = iconList;
-  while (currentIndex != index)
-  {
-    if (temporary == NULL) return;
-    previous = temporary;
-    temporary = temporary->next;
-    currentIndex++;
-  }
-  previous->next = temporary->next;
-  free(temporary);
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  timerDeadlines[timer] = 0;
 }
 
-unsigned int generateIconId()
+int waitForEvent(XEvent* event)
 {
-  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  int usedId = 0;
-  if (iconList == NULL) return usedId;
-  struct IconNode* current = iconList;
-  while (current != NULL)
+  if (DEBUG_MOTION_FUNCTIONS) printf("%s\n", __func__);
+  while (true)
   {
-    if (current->id == usedId)
+    // XPending also flushes the output buffer before we go to sleep
+    if (XPending(display) > 0)
     {
-      usedId++;
-      current = iconList;
+      XNextEvent(display, event);
+      return TIMER_NONE;
     }
-    else
+
+    uint64_t now = currentTime();
+    int nextTimer = TIMER_NONE;
+    for (int timer = 0; timer < TIMER_COUNT; timer++)
     {
-      current = current->next;
+      if (timerDeadlines[timer] == 0) continue;
+      if (nextTimer == TIMER_NONE || timerDeadlines[timer] < timerDeadlines[nextTimer]) nextTimer = timer;
+    }
+    if (nextTimer != TIMER_NONE && timerDeadlines[nextTimer] <= now)
+    {
+      timerDeadlines[nextTimer] = 0;
+      return nextTimer;
+    }
+
+    struct pollfd connections[2] =
+    {
+      { .fd = ConnectionNumber(display), .events = POLLIN, .revents = 0 },
+      { .fd = catalogNotify, .events = POLLIN, .revents = 0 },
+    };
+    struct timespec timeout;
+    if (nextTimer != TIMER_NONE)
+    {
+      uint64_t delay = timerDeadlines[nextTimer] - now;
+      timeout.tv_sec = delay / 1000000;
+      timeout.tv_nsec = (delay % 1000000) * 1000;
     }
+    ppoll(connections, catalogNotify >= 0 ? 2 : 1, nextTimer != TIMER_NONE ? &timeout : NULL, NULL);
+
+    // Catalog changes are applied as they arrive and never wake the caller
+    if (connections[1].revents & POLLIN) readCatalogChanges();
   }
-  return usedId;
 }
 
-void openTerminal()
+unsigned long calculateRGB(uint8_t red, u_int8_t green, uint8_t blue)
 {
-  system("cd $HOME && alacritty &");
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  return blue + (green << 8) + (red << 16);
 }
 
-unsigned long calculateRGB(uint8_t red, u_int8_t green, uint8_t blue)
+void freeIcons()
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  return blue + (green << 8) + (red << 16);
+  struct IconNode* current = iconList;
+  while (current != NULL)
+  {
+    struct IconNode* next = current->next;
+    destroyIcon(current);
+    current = next;
+  }
+  iconList = NULL;
+  rebuildIconTable();
+  free(iconTable);
+  iconTable = NULL;
+  iconTableCapacity = 0;
+  free(iconIdBitmap);
+  free(iconIdTable);
+  iconIdBitmap = NULL;
+  iconIdTable = NULL;
+  iconIdWordCount = 0;
+
+  while (arenaChunkList != NULL)
+  {
+    struct ArenaChunk* next = arenaChunkList->next;
+    free(arenaChunkList);
+    arenaChunkList = next;
+  }
+  freeIconNodeList = NULL;
+  memset(freeStringLists, 0, sizeof(freeStringLists));
 }
 
 void freePixelMaps()
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
-  struct IconNode* current = iconList;
+  struct IconImage* current = iconImageList;
   while (current != NULL)
   {
-    XFreePixmap(display, current->pixelMap);
-    current = current->next;
+    struct IconImage* next = current->next;
+    unloadIconImage(current);
+    if (!current->pixelDataMapped) free(current->pixelData);
+    free(current->path);
+    free(current);
+    current = next;
   }
+  iconImageList = NULL;
 }
 
 void freeTexts()
@@ -1022,10 +5033,114 @@ void freeTexts()
   free(iconMenuTexts);
 }
 
+void freeFont()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (DEBUG_TEXT_CACHE_STATS)
+  {
+    unsigned long lookups = textLabelStats.hits + textLabelStats.misses;
+    printf(
+      "Text label cache: %lu hits, %lu misses, %lu evictions, %.1f%% hit rate\n",
+      textLabelStats.hits,
+      textLabelStats.misses,
+      textLabelStats.evictions,
+      lookups > 0 ? 100.0 * textLabelStats.hits / lookups : 0.0
+    );
+  }
+  flushTextLabels();
+  if (font != NULL) XftFontClose(display, font);
+  font = NULL;
+}
+
 void freeXObjects()
 {
   if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  freeMenuBuffer();
+  if (panelBuffer != None) XFreePixmap(display, panelBuffer);
+  if (dialogBuffer != None) XFreePixmap(display, dialogBuffer);
+  XUngrabKey(display, AnyKey, AnyModifier, DefaultRootWindow(display));
+  if (triggerWindow != None) XDestroyWindow(display, triggerWindow);
   XFreeGC(display, panelGC);
-  XFreeGC(display, menuGC);
+  if (menuGC != NULL) XFreeGC(display, menuGC);
+  if (dialogGC != NULL) XFreeGC(display, dialogGC);
   XCloseDisplay(display);
 }
+
+void freeCandidates()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  for (int index = 0; index < applicationCandidateCount; index++)
+  {
+    releaseString(applicationCandidates[index].name);
+    releaseString(applicationCandidates[index].command);
+  }
+  free(applicationCandidates);
+  applicationCandidates = NULL;
+  applicationCandidateCount = 0;
+  applicationCandidateCapacity = 0;
+  dialogMatchCount = 0;
+}
+
+void freeHistory()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (historyCompactor > 0) finishHistoryCompaction(true);
+  for (int bucket = 0; bucket < HISTORY_BUCKET_COUNT; bucket++)
+  {
+    for (struct HistoryEntry* entry = historyBuckets[bucket]; entry != NULL; entry = entry->next)
+    {
+      releaseString(entry->command);
+    }
+    historyBuckets[bucket] = NULL;
+  }
+  historyEntryCount = 0;
+  if (historyFile >= 0) close(historyFile);
+  historyFile = -1;
+  free(historyPending);
+  historyPending = NULL;
+  historyPendingSize = 0;
+  historyPendingCapacity = 0;
+  free(historyCarry);
+  historyCarry = NULL;
+  historyCarrySize = 0;
+  historyCarryCapacity = 0;
+}
+
+void freeCatalog()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (catalogNotify >= 0) close(catalogNotify);
+  catalogNotify = -1;
+  for (int index = 0; index < pathDirectoryCount; index++)
+  {
+    free(pathDirectories[index].path);
+    free(pathDirectories[index].names);
+    free(pathDirectories[index].offsets);
+  }
+  free(pathDirectories);
+  free(catalogIndex);
+  pathDirectories = NULL;
+  pathDirectoryCount = 0;
+  catalogIndex = NULL;
+  catalogIndexCount = 0;
+  dialogMatchCount = 0;
+}
+
+void freeApplets()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  for (int index = 0; index < appletCount; index++)
+  {
+    applets[index].descriptor->destroy(applets[index].state);
+    dlclose(applets[index].library);
+  }
+  appletCount = 0;
+}
+
+void freeSnapshot()
+{
+  if (DEBUG_FUNCTIONS) printf("%s\n", __func__);
+  if (snapshotData != NULL) munmap((void*)snapshotData, snapshotSize);
+  snapshotData = NULL;
+  snapshotSize = 0;
+}
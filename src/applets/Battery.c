@@ -0,0 +1,86 @@
+#include "../Applet.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Battery State (capacity and status files of the first battery stay open)
+struct BatteryState
+{
+  int capacityFile;
+  int statusFile;
+  int percent;
+  bool charging;
+};
+
+void* createBattery()
+{
+  int capacityFile = open("/sys/class/power_supply/BAT0/capacity", O_RDONLY | O_CLOEXEC);
+  if (capacityFile < 0) return NULL;
+  struct BatteryState* battery = (struct BatteryState*)calloc(1, sizeof(struct BatteryState));
+  battery->capacityFile = capacityFile;
+  battery->statusFile = open("/sys/class/power_supply/BAT0/status", O_RDONLY | O_CLOEXEC);
+  battery->percent = -1;
+  return battery;
+}
+
+bool updateBattery(void* state)
+{
+  struct BatteryState* battery = (struct BatteryState*)state;
+  char buffer[32];
+  ssize_t length = pread(battery->capacityFile, buffer, sizeof(buffer) - 1, 0);
+  if (length <= 0) return false;
+  buffer[length] = '\0';
+  int percent = atoi(buffer);
+
+  bool charging = false;
+  if (battery->statusFile >= 0)
+  {
+    length = pread(battery->statusFile, buffer, sizeof(buffer) - 1, 0);
+    if (length > 0)
+    {
+      buffer[length] = '\0';
+      charging = strncmp(buffer, "Charging", 8) == 0;
+    }
+  }
+
+  if (percent == battery->percent && charging == battery->charging) return false;
+  battery->percent = percent;
+  battery->charging = charging;
+  return true;
+}
+
+void drawBattery(void* state, struct AppletCanvas* canvas)
+{
+  struct BatteryState* battery = (struct BatteryState*)state;
+  char text[16];
+  snprintf(text, sizeof(text), "BAT\n%d%%%s", battery->percent, battery->charging ? "+" : "");
+  canvas->drawText(canvas, text);
+  canvas->drawBar(canvas, battery->percent / 100.0f);
+}
+
+void destroyBattery(void* state)
+{
+  struct BatteryState* battery = (struct BatteryState*)state;
+  close(battery->capacityFile);
+  if (battery->statusFile >= 0) close(battery->statusFile);
+  free(battery);
+}
+
+const struct AppletDescriptor batteryDescriptor =
+{
+  .apiVersion = APPLET_API_VERSION,
+  .name = "battery",
+  .intervalMs = 10000,
+  .cellWidth = 40,
+  .create = createBattery,
+  .update = updateBattery,
+  .draw = drawBattery,
+  .destroy = destroyBattery,
+};
+
+const struct AppletDescriptor* u16panelApplet()
+{
+  return &batteryDescriptor;
+}
@@ -0,0 +1,57 @@
+#include "../Applet.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Clock State (last formatted time, redrawn only when the minute changes)
+struct ClockState
+{
+  char text[16];
+};
+
+void* createClock()
+{
+  return calloc(1, sizeof(struct ClockState));
+}
+
+bool updateClock(void* state)
+{
+  struct ClockState* clock = (struct ClockState*)state;
+  char text[16];
+  time_t now = time(NULL);
+  struct tm local;
+  localtime_r(&now, &local);
+  strftime(text, sizeof(text), "%H:%M", &local);
+  if (strcmp(text, clock->text) == 0) return false;
+  memcpy(clock->text, text, sizeof(text));
+  return true;
+}
+
+void drawClock(void* state, struct AppletCanvas* canvas)
+{
+  struct ClockState* clock = (struct ClockState*)state;
+  canvas->drawText(canvas, clock->text);
+}
+
+void destroyClock(void* state)
+{
+  free(state);
+}
+
+const struct AppletDescriptor clockDescriptor =
+{
+  .apiVersion = APPLET_API_VERSION,
+  .name = "clock",
+  .intervalMs = 1000,
+  .cellWidth = 48,
+  .create = createClock,
+  .update = updateClock,
+  .draw = drawClock,
+  .destroy = destroyClock,
+};
+
+const struct AppletDescriptor* u16panelApplet()
+{
+  return &clockDescriptor;
+}
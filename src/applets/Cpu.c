@@ -0,0 +1,80 @@
+#include "../Applet.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// CPU State (/proc/stat stays open, each tick rereads it from offset 0)
+struct CpuState
+{
+  int file;
+  unsigned long long lastBusy;
+  unsigned long long lastTotal;
+  int percent;
+};
+
+void* createCpu()
+{
+  int file = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+  if (file < 0) return NULL;
+  struct CpuState* cpu = (struct CpuState*)calloc(1, sizeof(struct CpuState));
+  cpu->file = file;
+  cpu->percent = -1;
+  return cpu;
+}
+
+bool updateCpu(void* state)
+{
+  struct CpuState* cpu = (struct CpuState*)state;
+  char buffer[256];
+  ssize_t length = pread(cpu->file, buffer, sizeof(buffer) - 1, 0);
+  if (length <= 0) return false;
+  buffer[length] = '\0';
+
+  unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+  if (sscanf(buffer, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) != 8) return false;
+  unsigned long long busy = user + nice + system + irq + softirq + steal;
+  unsigned long long total = busy + idle + iowait;
+
+  // Usage is the busy share of the jiffies since the previous tick
+  int percent = 0;
+  if (total > cpu->lastTotal) percent = (int)(100 * (busy - cpu->lastBusy) / (total - cpu->lastTotal));
+  cpu->lastBusy = busy;
+  cpu->lastTotal = total;
+  if (percent == cpu->percent) return false;
+  cpu->percent = percent;
+  return true;
+}
+
+void drawCpu(void* state, struct AppletCanvas* canvas)
+{
+  struct CpuState* cpu = (struct CpuState*)state;
+  char text[16];
+  snprintf(text, sizeof(text), "CPU\n%d%%", cpu->percent);
+  canvas->drawText(canvas, text);
+  canvas->drawBar(canvas, cpu->percent / 100.0f);
+}
+
+void destroyCpu(void* state)
+{
+  struct CpuState* cpu = (struct CpuState*)state;
+  close(cpu->file);
+  free(cpu);
+}
+
+const struct AppletDescriptor cpuDescriptor =
+{
+  .apiVersion = APPLET_API_VERSION,
+  .name = "cpu",
+  .intervalMs = 2000,
+  .cellWidth = 40,
+  .create = createCpu,
+  .update = updateCpu,
+  .draw = drawCpu,
+  .destroy = destroyCpu,
+};
+
+const struct AppletDescriptor* u16panelApplet()
+{
+  return &cpuDescriptor;
+}
@@ -0,0 +1,67 @@
+#include "../Applet.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Load State (/proc/loadavg stays open, the first field is shown as text)
+struct LoadState
+{
+  int file;
+  char text[16];
+};
+
+void* createLoad()
+{
+  int file = open("/proc/loadavg", O_RDONLY | O_CLOEXEC);
+  if (file < 0) return NULL;
+  struct LoadState* load = (struct LoadState*)calloc(1, sizeof(struct LoadState));
+  load->file = file;
+  return load;
+}
+
+bool updateLoad(void* state)
+{
+  struct LoadState* load = (struct LoadState*)state;
+  char buffer[64];
+  ssize_t length = pread(load->file, buffer, sizeof(buffer) - 1, 0);
+  if (length <= 0) return false;
+  buffer[length] = '\0';
+
+  char text[16];
+  snprintf(text, sizeof(text), "LOAD\n%.*s", (int)strcspn(buffer, " "), buffer);
+  if (strcmp(text, load->text) == 0) return false;
+  memcpy(load->text, text, sizeof(text));
+  return true;
+}
+
+void drawLoad(void* state, struct AppletCanvas* canvas)
+{
+  struct LoadState* load = (struct LoadState*)state;
+  canvas->drawText(canvas, load->text);
+}
+
+void destroyLoad(void* state)
+{
+  struct LoadState* load = (struct LoadState*)state;
+  close(load->file);
+  free(load);
+}
+
+const struct AppletDescriptor loadDescriptor =
+{
+  .apiVersion = APPLET_API_VERSION,
+  .name = "load",
+  .intervalMs = 5000,
+  .cellWidth = 40,
+  .create = createLoad,
+  .update = updateLoad,
+  .draw = drawLoad,
+  .destroy = destroyLoad,
+};
+
+const struct AppletDescriptor* u16panelApplet()
+{
+  return &loadDescriptor;
+}
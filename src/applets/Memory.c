@@ -0,0 +1,78 @@
+#include "../Applet.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Memory State (/proc/meminfo stays open, each tick rereads it from offset 0)
+struct MemoryState
+{
+  int file;
+  int percent;
+};
+
+void* createMemory()
+{
+  int file = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+  if (file < 0) return NULL;
+  struct MemoryState* memory = (struct MemoryState*)calloc(1, sizeof(struct MemoryState));
+  memory->file = file;
+  memory->percent = -1;
+  return memory;
+}
+
+bool updateMemory(void* state)
+{
+  struct MemoryState* memory = (struct MemoryState*)state;
+  char buffer[512];
+  ssize_t length = pread(memory->file, buffer, sizeof(buffer) - 1, 0);
+  if (length <= 0) return false;
+  buffer[length] = '\0';
+
+  // MemTotal and MemAvailable are both within the first few lines
+  const char* total = strstr(buffer, "MemTotal:");
+  const char* available = strstr(buffer, "MemAvailable:");
+  if (total == NULL || available == NULL) return false;
+  unsigned long long totalKb = strtoull(total + 9, NULL, 10);
+  unsigned long long availableKb = strtoull(available + 13, NULL, 10);
+  if (totalKb == 0) return false;
+
+  int percent = (int)(100 * (totalKb - availableKb) / totalKb);
+  if (percent == memory->percent) return false;
+  memory->percent = percent;
+  return true;
+}
+
+void drawMemory(void* state, struct AppletCanvas* canvas)
+{
+  struct MemoryState* memory = (struct MemoryState*)state;
+  char text[16];
+  snprintf(text, sizeof(text), "MEM\n%d%%", memory->percent);
+  canvas->drawText(canvas, text);
+  canvas->drawBar(canvas, memory->percent / 100.0f);
+}
+
+void destroyMemory(void* state)
+{
+  struct MemoryState* memory = (struct MemoryState*)state;
+  close(memory->file);
+  free(memory);
+}
+
+const struct AppletDescriptor memoryDescriptor =
+{
+  .apiVersion = APPLET_API_VERSION,
+  .name = "memory",
+  .intervalMs = 2000,
+  .cellWidth = 40,
+  .create = createMemory,
+  .update = updateMemory,
+  .draw = drawMemory,
+  .destroy = destroyMemory,
+};
+
+const struct AppletDescriptor* u16panelApplet()
+{
+  return &memoryDescriptor;
+}